@@ -0,0 +1,731 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/fl_draw.H>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Off-main-thread rendering for the custom widgets (see template.cpp).
+//
+// An async widget's content is a draw buffer (the word format of
+// draw_buffer.cpp) submitted from D. A worker thread rasterizes it into an RGB
+// pixel buffer, and draw() on the main thread only blits the newest finished
+// frame with fl_draw_image(), so a slow plot never holds up event handling.
+//
+// FLTK's drawing functions (Fl_Image_Surface included) share global driver
+// state and can't run off the main thread, so the worker uses the small
+// software rasterizer below: spans, Bresenham lines, even-odd polygon fill,
+// arcs as polylines, clip and matrix stacks as fl_draw.H has them, no
+// anti-aliasing. Indexed colors are resolved with the colormap copied at
+// submit time. Text needs the platform's fonts: DRAW_TEXT commands are kept
+// with their font, color and clip and drawn over the blit on the main thread.
+//
+// Frames are triple buffered: the worker renders into back, finished frames
+// wait in ready, draw() shows front. Newest wins everywhere: submitting while
+// a frame waits for the worker replaces it, and a finished frame replaces one
+// that wasn't shown yet, so neither side ever waits for the other. Finished
+// frames are announced through awake_post().
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846  // not in strict mode on MinGW
+#endif
+
+struct RasterText {
+	int x, y;
+	Fl_Font font;
+	Fl_Fontsize size;
+	Fl_Color color;
+	int cx, cy, cw, ch;  // clip, window coordinates
+	std::string text;
+};
+
+struct RasterJob {
+	std::vector<int> words;
+	int x, y, w, h;  // window area covered
+	unsigned background;
+	unsigned palette[256];
+	std::chrono::steady_clock::time_point submitted;
+};
+
+struct RasterFrame {
+	std::vector<uchar> pixels;
+	int x = 0, y = 0, w = 0, h = 0;
+	std::vector<RasterText> texts;
+	std::chrono::steady_clock::time_point submitted;
+	bool shown = false;
+};
+
+struct AsyncRaster {
+	Fl_Widget* widget;
+
+	RasterJob pending;  // newest submitted, waiting for the worker
+	RasterJob job;      // being rendered (worker only)
+	bool has_pending = false;
+	bool queued = false;
+	bool busy = false;
+	bool orphaned = false;  // freed while busy: the worker deletes it
+	bool in_done = false;
+
+	RasterFrame back, ready, front;
+	bool has_ready = false;
+
+	AsyncRasterStats stats = {};
+};
+
+struct RasterWorker {
+	std::mutex lock;
+	std::condition_variable wake;
+	std::deque<AsyncRaster*> jobs;
+	std::vector<AsyncRaster*> done;
+	bool started = false;
+};
+
+static void frames_ready(void*);
+
+// Never destroyed: the detached worker may still wait on it at exit.
+static RasterWorker& worker = *new RasterWorker();
+static AwakePost& worker_done = *new AwakePost{ frames_ready, nullptr };
+
+static double elapsed_ms(std::chrono::steady_clock::time_point since) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+struct RasterMatrix {
+	double a, b, c, d, x, y;
+};
+
+struct RasterClip {
+	int x0, y0, x1, y1;  // canvas pixels, exclusive end
+};
+
+// Software fl_draw.H for one frame. Coordinates come in window space and are
+// shifted by the frame's origin.
+class Canvas {
+public:
+	Canvas(RasterFrame& frame, const RasterJob& job);
+
+	int run(const int* words, size_t count);
+
+private:
+	void color(Fl_Color c);
+	void span(int y, int x0, int x1);
+	void plot(int x, int y);
+	void line(int x0, int y0, int x1, int y1);
+	void rectf(int x, int y, int w, int h);
+	void fill(const std::vector<double>& xy);
+	void arc_points(int x, int y, int w, int h, double a1, double a2, std::vector<double>& xy);
+	void end_shape(int op);
+	void push_clip(int x, int y, int w, int h);
+	void mult(double a, double b, double c, double d, double x, double y);
+
+	RasterFrame& frame;
+	const RasterJob& job;
+	uchar* pixels;
+	int w, h;
+
+	uchar rgb[3] = { 0, 0, 0 };
+	Fl_Color fl_color_ = FL_BLACK;
+	int line_width = 1;
+	Fl_Font font = FL_HELVETICA;
+	Fl_Fontsize size = FL_NORMAL_SIZE;
+
+	RasterClip clip;
+	std::vector<RasterClip> clips;
+	RasterMatrix m = { 1, 0, 0, 1, 0, 0 };
+	std::vector<RasterMatrix> matrices;
+	std::vector<double> vertices;  // canvas space
+	std::vector<double> scratch;
+};
+
+// Casting a double outside int's range is undefined, and vertices come from
+// the caller's matrix. Anything this far out is clipped away anyway.
+#define RASTER_FAR (1 << 28)
+
+static int to_pixel(double v) {
+	if (!(v > -RASTER_FAR))  // NaN too
+		return -RASTER_FAR;
+
+	return v < RASTER_FAR ? (int)v : RASTER_FAR;
+}
+
+Canvas::Canvas(RasterFrame& frame, const RasterJob& job): frame(frame), job(job) {
+	pixels = frame.pixels.data();
+	w = frame.w;
+	h = frame.h;
+	clip = RasterClip{ 0, 0, w, h };
+}
+
+void Canvas::color(Fl_Color c) {
+	unsigned v = (c & 0xffffff00) ? (unsigned)c : job.palette[c & 0xff];
+
+	fl_color_ = c;
+	rgb[0] = (uchar)(v >> 24);
+	rgb[1] = (uchar)(v >> 16);
+	rgb[2] = (uchar)(v >> 8);
+}
+
+void Canvas::span(int y, int x0, int x1) {
+	if (y < clip.y0 || y >= clip.y1)
+		return;
+
+	x0 = std::max(x0, clip.x0);
+	x1 = std::min(x1, clip.x1);
+
+	uchar* p = pixels + ((size_t)y * w + x0) * 3;
+
+	for (int x = x0; x < x1; x++, p += 3) {
+		p[0] = rgb[0];
+		p[1] = rgb[1];
+		p[2] = rgb[2];
+	}
+}
+
+// One pen dot: line_width pixels square.
+void Canvas::plot(int x, int y) {
+	int r = (line_width - 1) / 2;
+
+	for (int k = 0; k < line_width; k++)
+		span(y - r + k, x - r, x - r + line_width);
+}
+
+// Cohen-Sutherland outcode against the clip grown by the pen.
+static int outcode(long long x, long long y, long long x0, long long y0, long long x1, long long y1) {
+	return (x < x0 ? 1 : x > x1 ? 2 : 0) | (y < y0 ? 4 : y > y1 ? 8 : 0);
+}
+
+void Canvas::line(int ax, int ay, int bx, int by) {
+	// Clipped first, so a far off-canvas segment costs nothing instead of one
+	// plot per pixel of its length.
+	long long cx0 = clip.x0 - line_width, cy0 = clip.y0 - line_width;
+	long long cx1 = clip.x1 + line_width, cy1 = clip.y1 + line_width;
+	long long px = ax, py = ay, qx = bx, qy = by;
+	int pc = outcode(px, py, cx0, cy0, cx1, cy1);
+	int qc = outcode(qx, qy, cx0, cy0, cx1, cy1);
+
+	while (pc | qc) {
+		if (pc & qc)
+			return;
+
+		int c = pc ? pc : qc;
+		long long x, y;
+
+		if (c & 4) {
+			x = px + (qx - px) * (cy0 - py) / (qy - py);
+			y = cy0;
+		} else if (c & 8) {
+			x = px + (qx - px) * (cy1 - py) / (qy - py);
+			y = cy1;
+		} else if (c & 1) {
+			y = py + (qy - py) * (cx0 - px) / (qx - px);
+			x = cx0;
+		} else {
+			y = py + (qy - py) * (cx1 - px) / (qx - px);
+			x = cx1;
+		}
+
+		if (c == pc) {
+			px = x;
+			py = y;
+			pc = outcode(px, py, cx0, cy0, cx1, cy1);
+		} else {
+			qx = x;
+			qy = y;
+			qc = outcode(qx, qy, cx0, cy0, cx1, cy1);
+		}
+	}
+
+	int x0 = (int)px, y0 = (int)py, x1 = (int)qx, y1 = (int)qy;
+	int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+	int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+	int err = dx + dy;
+
+	for (;;) {
+		plot(x0, y0);
+
+		if (x0 == x1 && y0 == y1)
+			break;
+
+		int e2 = 2 * err;
+
+		if (e2 >= dy) {
+			err += dy;
+			x0 += sx;
+		}
+		if (e2 <= dx) {
+			err += dx;
+			y0 += sy;
+		}
+	}
+}
+
+void Canvas::rectf(int x, int y, int rw, int rh) {
+	int x0 = (int)std::max<long long>(clip.x0, x);
+	int y0 = (int)std::max<long long>(clip.y0, y);
+	int x1 = (int)std::min<long long>(clip.x1, (long long)x + rw);
+	int y1 = (int)std::min<long long>(clip.y1, (long long)y + rh);
+
+	for (int k = y0; k < y1 && x0 < x1; k++)
+		span(k, x0, x1);
+}
+
+// Even-odd scanline fill through pixel centers; xy holds x, y pairs.
+void Canvas::fill(const std::vector<double>& xy) {
+	size_t n = xy.size() / 2;
+
+	if (n < 3)
+		return;
+
+	double ymin = xy[1], ymax = xy[1];
+
+	for (size_t i = 1; i < n; i++) {
+		ymin = std::min(ymin, xy[i * 2 + 1]);
+		ymax = std::max(ymax, xy[i * 2 + 1]);
+	}
+
+	int y0 = std::max(clip.y0, to_pixel(floor(ymin)));
+	int y1 = std::min(clip.y1 - 1, to_pixel(ceil(ymax)));
+	std::vector<double>& xs = scratch;
+
+	for (int y = y0; y <= y1; y++) {
+		double cy = y + 0.5;
+
+		xs.clear();
+
+		for (size_t i = 0, j = n - 1; i < n; j = i++) {
+			double ax = xy[j * 2], ay = xy[j * 2 + 1];
+			double bx = xy[i * 2], by = xy[i * 2 + 1];
+
+			if ((ay <= cy) != (by <= cy))
+				xs.push_back(ax + (cy - ay) * (bx - ax) / (by - ay));
+		}
+
+		std::sort(xs.begin(), xs.end());
+
+		for (size_t k = 0; k + 1 < xs.size(); k += 2)
+			span(y, to_pixel(ceil(xs[k] - 0.5)), to_pixel(ceil(xs[k + 1] - 0.5)));
+	}
+}
+
+// Points of the elliptical arc in the box, angles in degrees counterclockwise
+// from 3 o'clock, like fl_arc(). Canvas space.
+void Canvas::arc_points(int x, int y, int bw, int bh, double a1, double a2, std::vector<double>& xy) {
+	double rx = bw / 2.0, ry = bh / 2.0;
+	double cx = x - frame.x + rx, cy = y - frame.y + ry;
+	int steps = std::max(8, std::min(4096, to_pixel(fabs(a2 - a1) / 360.0 * (rx + ry) * M_PI / 2)));
+
+	for (int i = 0; i <= steps; i++) {
+		double a = (a1 + (a2 - a1) * i / steps) * M_PI / 180;
+
+		xy.push_back(cx + rx * cos(a));
+		xy.push_back(cy - ry * sin(a));
+	}
+}
+
+void Canvas::end_shape(int op) {
+	size_t n = vertices.size() / 2;
+	std::vector<int> pts(n * 2);
+
+	for (size_t i = 0; i < n * 2; i++)
+		pts[i] = to_pixel(round(vertices[i]));
+
+	switch (op) {
+	case DRAW_END_POINTS:
+		for (size_t i = 0; i < n; i++)
+			span(pts[i * 2 + 1], pts[i * 2], pts[i * 2] + 1);
+		break;
+	case DRAW_END_LINE:
+	case DRAW_END_LOOP:
+		for (size_t i = 1; i < n; i++)
+			line(pts[i * 2 - 2], pts[i * 2 - 1], pts[i * 2], pts[i * 2 + 1]);
+
+		if (op == DRAW_END_LOOP && n > 2)
+			line(pts[n * 2 - 2], pts[n * 2 - 1], pts[0], pts[1]);
+		break;
+	case DRAW_END_POLYGON:
+		fill(vertices);
+		break;
+	}
+
+	vertices.clear();
+}
+
+// Intersects with the current clip, as fl_push_clip() does.
+void Canvas::push_clip(int x, int y, int cw, int ch) {
+	clips.push_back(clip);
+
+	x -= frame.x;
+	y -= frame.y;
+
+	clip.x0 = std::max(clip.x0, x);
+	clip.y0 = std::max(clip.y0, y);
+	clip.x1 = std::max(clip.x0, std::min(clip.x1, x + cw));
+	clip.y1 = std::max(clip.y0, std::min(clip.y1, y + ch));
+}
+
+// Same product as Fl_Graphics_Driver::mult_matrix().
+void Canvas::mult(double a, double b, double c, double d, double x, double y) {
+	RasterMatrix o;
+
+	o.a = a * m.a + b * m.c;
+	o.b = a * m.b + b * m.d;
+	o.c = c * m.a + d * m.c;
+	o.d = c * m.b + d * m.d;
+	o.x = x * m.a + y * m.c + m.x;
+	o.y = x * m.b + y * m.d + m.y;
+	m = o;
+}
+
+// Returns the number of commands executed, or -1 if the buffer is malformed.
+int Canvas::run(const int* words, size_t count) {
+	const int* p = words;
+	const int* end = words + count;
+	int ox = frame.x, oy = frame.y;
+	int commands = 0;
+
+	while (p < end) {
+		int op = *p++;
+
+		if (op < 0 || op >= DRAW_OP_COUNT || end - p < draw_op_arity[op])
+			return -1;
+
+		const int* a = p;
+		p += draw_op_arity[op];
+
+		switch (op) {
+		case DRAW_COLOR:
+			color((Fl_Color)a[0]);
+			break;
+		case DRAW_RECTF:
+			rectf(a[0] - ox, a[1] - oy, a[2], a[3]);
+			break;
+		case DRAW_RECT:
+			if (a[2] > 0 && a[3] > 0) {
+				rectf(a[0] - ox, a[1] - oy, a[2], 1);
+				rectf(a[0] - ox, a[1] - oy + a[3] - 1, a[2], 1);
+				rectf(a[0] - ox, a[1] - oy + 1, 1, a[3] - 2);
+				rectf(a[0] - ox + a[2] - 1, a[1] - oy + 1, 1, a[3] - 2);
+			}
+			break;
+		case DRAW_LINE:
+			line(a[0] - ox, a[1] - oy, a[2] - ox, a[3] - oy);
+			break;
+		case DRAW_POINT:
+			span(a[1] - oy, a[0] - ox, a[0] - ox + 1);
+			break;
+		case DRAW_BEGIN_POINTS:
+		case DRAW_BEGIN_LINE:
+		case DRAW_BEGIN_LOOP:
+		case DRAW_BEGIN_POLYGON:
+			vertices.clear();
+			break;
+		case DRAW_END_POINTS:
+		case DRAW_END_LINE:
+		case DRAW_END_LOOP:
+		case DRAW_END_POLYGON:
+			end_shape(op);
+			break;
+		case DRAW_VERTEX: {
+			double x = draw_word_float(a[0]), y = draw_word_float(a[1]);
+
+			vertices.push_back(x * m.a + y * m.c + m.x - ox);
+			vertices.push_back(x * m.b + y * m.d + m.y - oy);
+			break;
+		}
+		case DRAW_TEXT: {
+			int len = a[2];
+			int padded = (len + 3) / 4;
+
+			if (len < 0 || end - p < padded)
+				return -1;
+
+			frame.texts.push_back(RasterText{ a[0], a[1], font, size, fl_color_,
+				clip.x0 + ox, clip.y0 + oy, clip.x1 - clip.x0, clip.y1 - clip.y0, std::string((const char*)p, len) });
+			p += padded;
+			break;
+		}
+		case DRAW_FONT:
+			font = (Fl_Font)a[0];
+			size = (Fl_Fontsize)a[1];
+			break;
+		case DRAW_LINE_STYLE:
+			line_width = a[1] > 0 ? a[1] : 1;
+			break;
+		case DRAW_PUSH_CLIP:
+			push_clip(a[0], a[1], a[2], a[3]);
+			break;
+		case DRAW_POP_CLIP:
+			if (!clips.empty()) {
+				clip = clips.back();
+				clips.pop_back();
+			}
+			break;
+		case DRAW_PUSH_MATRIX:
+			matrices.push_back(m);
+			break;
+		case DRAW_POP_MATRIX:
+			if (!matrices.empty()) {
+				m = matrices.back();
+				matrices.pop_back();
+			}
+			break;
+		case DRAW_TRANSLATE:
+			mult(1, 0, 0, 1, draw_word_float(a[0]), draw_word_float(a[1]));
+			break;
+		case DRAW_SCALE:
+			mult(draw_word_float(a[0]), 0, 0, draw_word_float(a[1]), 0, 0);
+			break;
+		case DRAW_ARC:
+		case DRAW_PIE: {
+			std::vector<double> xy;
+
+			if (op == DRAW_PIE) {
+				xy.push_back(a[0] - ox + a[2] / 2.0);
+				xy.push_back(a[1] - oy + a[3] / 2.0);
+			}
+
+			arc_points(a[0], a[1], a[2], a[3], draw_word_float(a[4]), draw_word_float(a[5]), xy);
+
+			if (op == DRAW_PIE) {
+				fill(xy);
+			} else {
+				for (size_t i = 2; i < xy.size(); i += 2)
+					line(to_pixel(round(xy[i - 2])), to_pixel(round(xy[i - 1])), to_pixel(round(xy[i])), to_pixel(round(xy[i + 1])));
+			}
+			break;
+		}
+		}
+
+		commands++;
+	}
+
+	return commands;
+}
+
+// Renders r->job into r->back (worker thread, no locks held).
+static void render(AsyncRaster* r) {
+	RasterJob& job = r->job;
+	RasterFrame& frame = r->back;
+	size_t bytes = (size_t)job.w * job.h * 3;
+
+	frame.x = job.x;
+	frame.y = job.y;
+	frame.w = job.w;
+	frame.h = job.h;
+	frame.submitted = job.submitted;
+	frame.shown = false;
+	frame.texts.clear();
+	frame.pixels.resize(bytes);
+
+	// The widget's color first, as its box would have been.
+	unsigned bg = job.background;
+	uchar* px = frame.pixels.data();
+
+	for (size_t i = 0; i < bytes; i += 3) {
+		px[i] = (uchar)(bg >> 24);
+		px[i + 1] = (uchar)(bg >> 16);
+		px[i + 2] = (uchar)(bg >> 8);
+	}
+
+	Canvas canvas(frame, job);
+	canvas.run(job.words.data(), job.words.size());
+}
+
+static void frames_ready(void*) {
+	std::vector<AsyncRaster*> done;
+
+	awake_drained(worker_done);
+
+	{
+		std::lock_guard<std::mutex> guard(worker.lock);
+		done.swap(worker.done);
+
+		for (AsyncRaster* r : done)
+			r->in_done = false;
+	}
+
+	for (AsyncRaster* r : done)
+		r->widget->redraw();
+}
+
+static void raster_worker() {
+	std::unique_lock<std::mutex> guard(worker.lock);
+
+	for (;;) {
+		worker.wake.wait(guard, [] { return !worker.jobs.empty(); });
+
+		AsyncRaster* r = worker.jobs.front();
+		worker.jobs.pop_front();
+		r->queued = false;
+		r->busy = true;
+		std::swap(r->job, r->pending);
+		r->has_pending = false;
+		guard.unlock();
+
+		auto start = std::chrono::steady_clock::now();
+		render(r);
+		double ms = elapsed_ms(start);
+
+		guard.lock();
+		r->busy = false;
+
+		if (r->orphaned) {
+			delete r;
+			continue;
+		}
+
+		r->stats.rendered++;
+		r->stats.last_render_ms = ms;
+		r->stats.max_render_ms = std::max(r->stats.max_render_ms, ms);
+
+		if (r->has_ready)
+			r->stats.dropped++;
+
+		std::swap(r->back, r->ready);
+		r->has_ready = true;
+
+		if (!r->in_done) {
+			r->in_done = true;
+			worker.done.push_back(r);
+		}
+
+		// Submitted while we were rendering.
+		if (r->has_pending) {
+			r->queued = true;
+			worker.jobs.push_back(r);
+		}
+
+		// r may be freed once the lock is released.
+		guard.unlock();
+		awake_post(worker_done);
+		guard.lock();
+	}
+}
+
+extern "C" AsyncRaster* AsyncRaster_Create(Fl_Widget* w) {
+	AsyncRaster* r = new AsyncRaster();
+
+	r->widget = w;
+	return r;
+}
+
+// Copies words (window coordinates, as for DrawBuffer_Replay) to be rendered
+// over w's area. Replaces a frame still waiting for the worker.
+extern "C" void AsyncRaster_Submit(AsyncRaster* r, Fl_Widget* w, const int* words, size_t count) {
+	std::lock_guard<std::mutex> guard(worker.lock);
+	RasterJob& job = r->pending;
+
+	if (r->has_pending)
+		r->stats.dropped++;
+
+	job.words.assign(words, words + count);
+	job.x = w->x();
+	job.y = w->y();
+	job.w = w->w() > 0 ? w->w() : 0;
+	job.h = w->h() > 0 ? w->h() : 0;
+	job.submitted = std::chrono::steady_clock::now();
+
+	// The worker can't ask FLTK for indexed colors.
+	for (unsigned c = 0; c < 256; c++)
+		job.palette[c] = Fl::get_color((Fl_Color)c);
+
+	job.background = Fl::get_color(w->color());
+
+	r->has_pending = true;
+	r->stats.submitted++;
+
+	if (!r->busy && !r->queued) {
+		r->queued = true;
+		worker.jobs.push_back(r);
+		worker.wake.notify_one();
+	}
+
+	if (!worker.started) {
+		worker.started = true;
+		std::thread(raster_worker).detach();
+	}
+}
+
+// Blits the newest finished frame; never waits for the worker.
+extern "C" void AsyncRaster_Draw(AsyncRaster* r, Fl_Widget* w) {
+	auto start = std::chrono::steady_clock::now();
+
+	{
+		std::lock_guard<std::mutex> guard(worker.lock);
+
+		if (r->has_ready) {
+			std::swap(r->front, r->ready);
+			r->has_ready = false;
+		}
+	}
+
+	RasterFrame& f = r->front;
+
+	fl_push_clip(w->x(), w->y(), w->w(), w->h());
+
+	if (f.w > 0 && f.h > 0) {
+		int dx = w->x() - f.x, dy = w->y() - f.y;
+
+		fl_draw_image(f.pixels.data(), w->x(), w->y(), f.w, f.h, 3, f.w * 3);
+
+		for (const RasterText& t : f.texts) {
+			fl_push_clip(t.cx + dx, t.cy + dy, t.cw, t.ch);
+			fl_font(t.font, t.size);
+			fl_color(t.color);
+			fl_draw(t.text.data(), (int)t.text.size(), t.x + dx, t.y + dy);
+			fl_pop_clip();
+		}
+	}
+
+	// Not rendered yet, or the widget grew since.
+	if (f.w < w->w() || f.h < w->h()) {
+		fl_color(w->color());
+
+		if (f.w < w->w())
+			fl_rectf(w->x() + f.w, w->y(), w->w() - f.w, w->h());
+		if (f.h < w->h())
+			fl_rectf(w->x(), w->y() + f.h, w->w(), w->h() - f.h);
+	}
+
+	fl_pop_clip();
+
+	std::lock_guard<std::mutex> guard(worker.lock);
+
+	if (f.w > 0 && !f.shown) {
+		f.shown = true;
+		r->stats.last_latency_ms = elapsed_ms(f.submitted);
+	}
+
+	double ms = elapsed_ms(start);
+
+	r->stats.blits++;
+	r->stats.last_draw_ms = ms;
+	r->stats.max_draw_ms = std::max(r->stats.max_draw_ms, ms);
+}
+
+// Safe while the worker renders r: it is then deleted when that finishes.
+extern "C" void AsyncRaster_Free(AsyncRaster* r) {
+	if (r == nullptr)
+		return;
+
+	std::lock_guard<std::mutex> guard(worker.lock);
+
+	if (r->queued)
+		worker.jobs.erase(std::find(worker.jobs.begin(), worker.jobs.end(), r));
+	if (r->in_done)
+		worker.done.erase(std::find(worker.done.begin(), worker.done.end(), r));
+
+	if (r->busy)
+		r->orphaned = true;
+	else
+		delete r;
+}
+
+extern "C" void AsyncRaster_Stats(AsyncRaster* r, AsyncRasterStats* stats) {
+	std::lock_guard<std::mutex> guard(worker.lock);
+	*stats = r->stats;
+}
@@ -0,0 +1,28 @@
+#include "fltk_d_wrapper.h"
+#include <chrono>
+#include <thread>
+
+// Hands results from worker threads to the main thread with Fl::awake().
+//
+// Posting the handler once per result would fill FLTK's awake ring during a
+// burst, so a post is skipped while an earlier one hasn't run yet: the handler
+// calls awake_drained() before taking what is queued and picks up the later
+// results too. Fl::awake() fails when the ring is full; the post is then
+// retried until the main thread has made room, since nothing else would ever
+// post again while the flag is set.
+//
+// awake_post() must be called without holding any lock the handler takes. As
+// with Fl::awake() itself, the main thread must have called Fl::lock() once
+// before entering the event loop.
+
+void awake_post(AwakePost& post) {
+	if (post.pending.exchange(true, std::memory_order_acq_rel))
+		return;
+
+	while (Fl::awake(post.handler, post.data) != 0)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+void awake_drained(AwakePost& post) {
+	post.pending.store(false, std::memory_order_release);
+}
@@ -0,0 +1,123 @@
+#include <Fl/Fl_Double_Window.H>
+#include <Fl/Fl_Group.H>
+#include <Fl/Fl_Box.H>
+#include <chrono>
+#include <stdio.h>
+
+// Resize drag over a 10k-widget window: Fl_Group (every child rescaled from
+// sizes() on every step) against Flex_Grid (wrapper/flex_layout.cpp, laid out
+// once per step and only where something changed).
+//
+// 100 rows of 100 boxes. The rows have a fixed height except the last one, so
+// dragging the bottom edge only changes that row: Fl_Group still visits all
+// 10k boxes per step, Flex_Grid moves the 100 boxes of the last row.
+//
+// Built and run by make bench in the wrapper directory.
+
+#define ROWS 100
+#define COLUMNS 100
+#define STEPS 500
+
+struct FlexLayoutStats {
+	long long layouts;
+	long long measures;
+	long long moved;
+	long long kept;
+};
+
+struct Flex_Grid;
+
+extern "C" {
+	Flex_Grid* FlexLayout_Create(int x, int y, int w, int h, const char* label);
+	void FlexLayout_SetMode(Flex_Grid* f, int mode, int columns);
+	void FlexLayout_SetCell(Flex_Grid* f, Fl_Widget* w, int size, int min, int weight);
+	void FlexLayout_Layout(Flex_Grid* f);
+	void FlexLayout_Stats(FlexLayoutStats* out, int reset);
+}
+
+#define FLEX_ROW 0
+#define FLEX_COLUMN 1
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char* what, double seconds) {
+	printf("%-10s %d steps in %.3f s: %.1f steps/s, %.1f us/step\n", what, STEPS, seconds, STEPS / seconds,
+		seconds * 1e6 / STEPS);
+}
+
+static void bench_group() {
+	Fl_Double_Window* win = new Fl_Double_Window(0, 0, COLUMNS * 10, ROWS * 10);
+
+	for (int r = 0; r < ROWS; r++) {
+		Fl_Group* row = new Fl_Group(0, r * 10, COLUMNS * 10, 10);
+
+		for (int c = 0; c < COLUMNS; c++)
+			new Fl_Box(c * 10, r * 10, 10, 10);
+
+		row->end();
+
+		if (r == ROWS - 1)
+			win->resizable(row);
+	}
+
+	win->end();
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < STEPS; i++)
+		win->size(COLUMNS * 10, ROWS * 10 + 1 + i % 200);
+
+	report("Fl_Group", seconds_since(start));
+	delete win;
+}
+
+static void bench_flex() {
+	Fl_Double_Window* win = new Fl_Double_Window(0, 0, COLUMNS * 10, ROWS * 10);
+	Flex_Grid* column = FlexLayout_Create(0, 0, COLUMNS * 10, ROWS * 10, nullptr);
+	FlexLayoutStats stats;
+
+	FlexLayout_SetMode(column, FLEX_COLUMN, 0);
+
+	for (int r = 0; r < ROWS; r++) {
+		Flex_Grid* row = FlexLayout_Create(0, r * 10, COLUMNS * 10, 10, nullptr);
+
+		FlexLayout_SetMode(row, FLEX_ROW, 0);
+
+		for (int c = 0; c < COLUMNS; c++)
+			FlexLayout_SetCell(row, new Fl_Box(c * 10, r * 10, 10, 10), -1, 0, 1);
+
+		((Fl_Group*)row)->end();
+		FlexLayout_SetCell(column, (Fl_Widget*)row, 10, 0, r == ROWS - 1);
+	}
+
+	((Fl_Group*)column)->end();
+	win->end();
+	win->resizable((Fl_Widget*)column);
+
+	// The first layout places everything.
+	FlexLayout_Layout(column);
+	FlexLayout_Stats(&stats, 1);
+
+	auto start = std::chrono::steady_clock::now();
+
+	// One layout per step stands for the draw() that follows each resize.
+	for (int i = 0; i < STEPS; i++) {
+		win->size(COLUMNS * 10, ROWS * 10 + 1 + i % 200);
+		FlexLayout_Layout(column);
+	}
+
+	report("Flex_Grid", seconds_since(start));
+	FlexLayout_Stats(&stats, 1);
+	printf("           %lld layouts, %lld measures, %lld moved, %lld kept\n", stats.layouts, stats.measures,
+		stats.moved, stats.kept);
+	delete win;
+}
+
+int main() {
+	printf("%d widgets\n", ROWS * COLUMNS + ROWS + 1);
+	bench_group();
+	bench_flex();
+	return 0;
+}
@@ -0,0 +1,114 @@
+#include <Fl/Fl_Image.H>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Frames/s of FrameSurface_Update() (wrapper/frame_surface.cpp) at 4K, per
+// source format, against the scalar convert-and-wrap loop it replaces: BGRA
+// swizzled byte by byte into a new buffer wrapped in a new Fl_RGB_Image per
+// frame.
+//
+// Conversion and image update only; drawing the frame costs the same either
+// way and depends on the display.
+//
+// Built and run by make bench in the wrapper directory.
+
+#define WIDTH 3840
+#define HEIGHT 2160
+#define FRAMES 60
+
+struct FrameSurfaceStats {
+	long long frames;
+	long long copied_frames;
+	double last_convert_ms;
+	double total_convert_ms;
+};
+
+struct FrameSurface;
+
+extern "C" {
+	FrameSurface* FrameSurface_Create();
+	void FrameSurface_Destroy(FrameSurface* s);
+	int FrameSurface_Update(FrameSurface* s, const void* data, int w, int h, int stride, int format);
+	void FrameSurface_Stats(FrameSurface* s, FrameSurfaceStats* stats);
+}
+
+static const char* format_names[] = {
+	"rgb24", "rgba32", "bgra32", "rgba32_premul", "bgra32_premul", "gray8", "gray16", "i420", "nv12",
+};
+
+// Bytes of a tightly packed WIDTH x HEIGHT frame.
+static size_t frame_size(int format) {
+	switch (format) {
+	case 0: return (size_t)WIDTH * HEIGHT * 3;
+	case 5: return (size_t)WIDTH * HEIGHT;
+	case 6: return (size_t)WIDTH * HEIGHT * 2;
+	case 7:
+	case 8: return (size_t)WIDTH * HEIGHT * 3 / 2;
+	default: return (size_t)WIDTH * HEIGHT * 4;
+	}
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char* what, double seconds) {
+	printf("%-16s %6.1f frames/s  %7.2f ms/frame\n", what, FRAMES / seconds, seconds * 1e3 / FRAMES);
+}
+
+static void bench_scalar(const std::vector<unsigned char>& frame) {
+	auto start = std::chrono::steady_clock::now();
+
+	for (int f = 0; f < FRAMES; f++) {
+		unsigned char* out = new unsigned char[(size_t)WIDTH * HEIGHT * 4];
+		const unsigned char* src = frame.data();
+
+		for (size_t i = 0; i < (size_t)WIDTH * HEIGHT; i++) {
+			out[4 * i] = src[4 * i + 2];
+			out[4 * i + 1] = src[4 * i + 1];
+			out[4 * i + 2] = src[4 * i];
+			out[4 * i + 3] = src[4 * i + 3];
+		}
+
+		Fl_RGB_Image* img = new Fl_RGB_Image(out, WIDTH, HEIGHT, 4);
+
+		img->alloc_array = 1;
+		delete img;
+	}
+
+	report("scalar bgra32", seconds_since(start));
+}
+
+int main() {
+	std::vector<unsigned char> frame(frame_size(2));
+
+	for (size_t i = 0; i < frame.size(); i++)
+		frame[i] = (unsigned char)rand();
+
+	printf("%dx%d, %d frames per format\n", WIDTH, HEIGHT, FRAMES);
+	bench_scalar(frame);
+
+	for (int format = 0; format < (int)(sizeof(format_names) / sizeof(format_names[0])); format++) {
+		FrameSurface* s = FrameSurface_Create();
+		FrameSurfaceStats stats;
+		auto start = std::chrono::steady_clock::now();
+
+		for (int f = 0; f < FRAMES; f++)
+			FrameSurface_Update(s, frame.data(), WIDTH, HEIGHT, 0, format);
+
+		double seconds = seconds_since(start);
+
+		FrameSurface_Stats(s, &stats);
+		report(format_names[format], seconds);
+
+		if (stats.copied_frames == 0)
+			printf("                 (drawn from the caller's buffer, no copy)\n");
+
+		FrameSurface_Destroy(s);
+	}
+
+	return 0;
+}
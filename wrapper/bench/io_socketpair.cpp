@@ -0,0 +1,235 @@
+#include <Fl/Fl.H>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <sys/socket.h>
+
+// IoReactor (wrapper/io_reactor.cpp) over a socketpair, driven by the FLTK
+// loop: receive buffer back pressure, a large write queued and drained on
+// EPOLLOUT, a peer close, and closing the reactor from its own dispatch.
+// Prints the throughput of the transfer and exits 1 on the first failed check.
+//
+// Linux only. Built and run by make bench in the wrapper directory.
+
+#define IO_READ 1
+#define IO_WRITE 2
+#define IO_RECV 4
+#define IO_HUP 8
+#define IO_ERROR 16
+
+#define RECV_BUFFER 4096
+#define TRANSFER (16 << 20)
+
+struct IoEvent {
+	int fd;
+	int events;
+	void* data;
+	const char* recv;
+	size_t recv_len;
+	int error;
+};
+
+struct IoReactorStats {
+	long long wakeups;
+	long long events;
+	long long batches;
+	long long bytes_in;
+	long long bytes_out;
+	int watches;
+};
+
+struct IoReactor;
+
+typedef void (*IoDispatchProc)(void* data, const IoEvent* events, size_t count);
+
+extern "C" {
+	IoReactor* IoReactor_Create(int max_events, IoDispatchProc dispatch, void* data);
+	void IoReactor_Destroy(IoReactor* r);
+	int IoReactor_Add(IoReactor* r, int fd, int flags, size_t recv_buffer, void* data);
+	int IoReactor_Remove(IoReactor* r, int fd);
+	void IoReactor_Consume(IoReactor* r, int fd, size_t n);
+	const char* IoReactor_Received(IoReactor* r, int fd, size_t* len);
+	long long IoReactor_Write(IoReactor* r, int fd, const char* bytes, size_t len);
+	void IoReactor_Stats(IoReactor* r, IoReactorStats* stats);
+}
+
+static IoReactor* reactor;
+static bool consume = true;
+static size_t received, recv_events, largest;
+static unsigned checksum;
+static int drained, hangups, errors;
+
+static void check(bool ok, const char* what) {
+	if (!ok) {
+		printf("FAILED: %s\n", what);
+		exit(1);
+	}
+}
+
+static void dispatch(void*, const IoEvent* events, size_t count) {
+	for (size_t k = 0; k < count; k++) {
+		const IoEvent& ev = events[k];
+
+		if (ev.events & IO_RECV) {
+			recv_events++;
+
+			if (ev.recv_len > largest)
+				largest = ev.recv_len;
+
+			if (consume) {
+				for (size_t i = 0; i < ev.recv_len; i++)
+					checksum = checksum * 31 + (unsigned char)ev.recv[i];
+
+				received += ev.recv_len;
+				IoReactor_Consume(reactor, ev.fd, ev.recv_len);
+			}
+		}
+
+		if (ev.events & IO_WRITE)
+			drained++;
+		if (ev.events & IO_HUP)
+			hangups++;
+		if (ev.events & IO_ERROR)
+			errors++;
+	}
+}
+
+// Runs the loop until done(), for five seconds at most.
+template <typename Done>
+static void run_until(Done done) {
+	auto start = std::chrono::steady_clock::now();
+
+	while (!done() && std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+		Fl::wait(0.05);
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void test_back_pressure(int a, int b) {
+	std::string chunk(RECV_BUFFER * 4, 'x');
+
+	consume = false;
+	recv_events = largest = 0;
+	check(write(a, chunk.data(), chunk.size()) == (ssize_t)chunk.size(), "write to the peer");
+	run_until([] { return largest == RECV_BUFFER; });
+	check(largest == RECV_BUFFER, "a full receive buffer is reported");
+
+	// Full and unconsumed: the reactor stops reading, the loop stays quiet.
+	size_t seen = recv_events;
+
+	for (int i = 0; i < 5; i++)
+		Fl::wait(0.01);
+
+	check(recv_events == seen, "no events while the buffer is full");
+
+	size_t len;
+
+	IoReactor_Received(reactor, b, &len);
+	IoReactor_Consume(reactor, b, len);
+	consume = true;
+	received = len;
+	run_until([&] { return received == chunk.size(); });
+	check(received == chunk.size(), "the rest arrives once consumed");
+	printf("back pressure: %zu bytes through a %d byte buffer\n", received, RECV_BUFFER);
+}
+
+static void test_transfer(int a) {
+	std::string data(TRANSFER, '\0');
+	unsigned expected = 0;
+
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = (char)(i * 7 + (i >> 12));
+		expected = expected * 31 + (unsigned char)data[i];
+	}
+
+	received = 0;
+	checksum = 0;
+	drained = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	long long queued = IoReactor_Write(reactor, a, data.data(), data.size());
+
+	check(queued > 0, "a large write is queued behind the socket buffer");
+	run_until([] { return drained > 0 && received == TRANSFER; });
+
+	double seconds = seconds_since(start);
+
+	check(drained == 1, "IO_WRITE once the queue drained");
+	check(received == TRANSFER && checksum == expected, "every byte received in order");
+	printf("transfer: %d MB in %.3f s, %.1f MB/s (%lld bytes queued at first)\n", TRANSFER >> 20, seconds,
+		TRANSFER / seconds / (1 << 20), queued);
+}
+
+static void test_peer_close(int a, int b) {
+	const char tail[] = "last words";
+
+	received = 0;
+	hangups = 0;
+	check(write(a, tail, sizeof(tail)) == (ssize_t)sizeof(tail), "write before closing");
+	IoReactor_Remove(reactor, a);
+	close(a);
+	run_until([] { return hangups > 0; });
+	check(received == sizeof(tail), "data before the close is delivered");
+	check(hangups == 1 && errors == 0, "one IO_HUP for the closed peer");
+
+	for (int i = 0; i < 5; i++)
+		Fl::wait(0.01);
+
+	check(hangups == 1, "no events after IO_HUP");
+	IoReactor_Remove(reactor, b);
+	close(b);
+}
+
+static IoReactor* closing;
+static int closed_in_dispatch;
+
+static void close_from_dispatch(void*, const IoEvent*, size_t count) {
+	// The rest of the batch is still delivered; the reactor is freed after it.
+	IoReactor_Destroy(closing);
+	closed_in_dispatch += (int)count;
+}
+
+static void test_close_in_dispatch() {
+	int sv[2], sw[2];
+
+	check(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0 && socketpair(AF_UNIX, SOCK_STREAM, 0, sw) == 0, "socketpair");
+	closing = IoReactor_Create(16, close_from_dispatch, nullptr);
+	IoReactor_Add(closing, sv[1], IO_RECV, 0, nullptr);
+	IoReactor_Add(closing, sw[1], IO_RECV, 0, nullptr);
+	check(write(sv[0], "a", 1) == 1 && write(sw[0], "b", 1) == 1, "write");
+	run_until([] { return closed_in_dispatch > 0; });
+	check(closed_in_dispatch == 2, "closing from the dispatch still delivers the batch");
+
+	close(sv[0]);
+	close(sv[1]);
+	close(sw[0]);
+	close(sw[1]);
+	printf("closed from its own dispatch\n");
+}
+
+int main() {
+	int sv[2];
+
+	check(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0, "socketpair");
+	reactor = IoReactor_Create(64, dispatch, nullptr);
+	check(reactor != nullptr, "epoll reactor");
+	check(IoReactor_Add(reactor, sv[1], IO_RECV, RECV_BUFFER, nullptr) == 0, "add the receiving end");
+	check(IoReactor_Add(reactor, sv[0], IO_WRITE, 0, nullptr) == 0, "add the sending end");
+
+	test_back_pressure(sv[0], sv[1]);
+	test_transfer(sv[0]);
+	test_peer_close(sv[0], sv[1]);
+
+	IoReactorStats stats;
+
+	IoReactor_Stats(reactor, &stats);
+	printf("%lld wakeups, %lld events in %lld batches\n", stats.wakeups, stats.events, stats.batches);
+	IoReactor_Destroy(reactor);
+
+	test_close_in_dispatch();
+	return 0;
+}
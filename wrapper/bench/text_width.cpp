@@ -0,0 +1,120 @@
+#include <Fl/Fl.H>
+#include <Fl/fl_draw.H>
+#include <Fl/platform.H>
+#include <chrono>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Layout of a 10k-row, 4-column browser measured with fl_width() against the
+// TextMeasure cache (wrapper/text_measure.cpp), cold and warm, with and
+// without the ASCII fast path. A layout pass measures every cell and keeps
+// the widest per column, as a browser computing its column widths does on
+// every redraw.
+//
+// Needs a display (fl_width() asks the graphics driver). Built and run by
+// make bench in the wrapper directory.
+
+#define ROWS 10000
+#define COLUMNS 4
+#define PASSES 20
+
+struct TextMeasureStats {
+	long long hits;
+	long long misses;
+	long long ascii_hits;
+	long long clears;
+	int entries;
+};
+
+extern "C" {
+	void TextMeasure_Configure(int max_entries, int ascii_fast_path);
+	double TextMeasure_Width(const char* s, int n);
+	void TextMeasure_Clear();
+	void TextMeasure_Stats(TextMeasureStats* stats);
+}
+
+static const char* states[] = { "idle", "running", "stopped", "waiting for input", "done" };
+
+static std::vector<std::string> cells;
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char* what, double seconds, int passes) {
+	printf("%-20s %8.2f ms/layout\n", what, seconds * 1e3 / passes);
+}
+
+template <typename Measure>
+static double layout(Measure measure) {
+	double widths[COLUMNS] = {};
+
+	for (size_t i = 0; i < cells.size(); i++) {
+		double w = measure(cells[i]);
+
+		if (w > widths[i % COLUMNS])
+			widths[i % COLUMNS] = w;
+	}
+
+	return widths[0] + widths[1] + widths[2] + widths[3];
+}
+
+static void bench_uncached() {
+	auto start = std::chrono::steady_clock::now();
+
+	for (int p = 0; p < PASSES; p++)
+		layout([](const std::string& s) { return fl_width(s.data(), (int)s.size()); });
+
+	report("fl_width", seconds_since(start), PASSES);
+}
+
+static void bench_cached(const char* what, int ascii_fast_path) {
+	TextMeasureStats stats;
+
+	TextMeasure_Clear();
+	TextMeasure_Configure(4 * ROWS * COLUMNS, ascii_fast_path);
+
+	auto measure = [](const std::string& s) { return TextMeasure_Width(s.data(), (int)s.size()); };
+	auto start = std::chrono::steady_clock::now();
+
+	layout(measure);
+
+	std::string cold = std::string(what) + ", cold";
+	report(cold.c_str(), seconds_since(start), 1);
+
+	start = std::chrono::steady_clock::now();
+
+	for (int p = 0; p < PASSES; p++)
+		layout(measure);
+
+	std::string warm = std::string(what) + ", warm";
+	report(warm.c_str(), seconds_since(start), PASSES);
+
+	TextMeasure_Stats(&stats);
+	printf("                     %lld hits, %lld misses, %lld ascii, %d entries\n", stats.hits, stats.misses,
+		stats.ascii_hits, stats.entries);
+}
+
+int main() {
+	char buf[64];
+
+	fl_open_display();
+	fl_font(FL_HELVETICA, 14);
+
+	for (int r = 0; r < ROWS; r++) {
+		snprintf(buf, sizeof(buf), "%d", r + 1);
+		cells.push_back(buf);
+		snprintf(buf, sizeof(buf), "process-%04d.service", r % 500);
+		cells.push_back(buf);
+		cells.push_back(states[r % 5]);
+		snprintf(buf, sizeof(buf), "%d.%d MB", (r * 37) % 900, r % 10);
+		cells.push_back(buf);
+	}
+
+	printf("%d rows x %d columns, %d layouts\n", ROWS, COLUMNS, PASSES);
+	bench_uncached();
+	bench_cached("cache", 0);
+	bench_cached("cache + ascii", 1);
+	return 0;
+}
@@ -0,0 +1,144 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/Fl_Group.H>
+#include <stdlib.h>
+
+// Widget callbacks registered from D.
+//
+// Entries live in fixed-size slabs that are never moved or freed, so a widget's
+// user_data can point straight at its entry and every widget shares the same
+// trampoline. Registering, re-registering and dispatching don't allocate once
+// the pool is warm.
+//
+// Entries are given back from the destruction path, never through FLTK's
+// widget watch list (a flat array scanned by every ~Fl_Widget). A Custom
+// widget releases its own entry and those of everything inside it from its
+// destructor, while its children still exist; so do Virtual_List,
+// Virtual_Browser and Virtual_Table. Plain widgets outside those are released
+// when D deletes them with DeleteWidget() or ClearGroup(), or when the proxy
+// owning them deletes them (the unref feature in fltk_d.i).
+
+#define CALLBACK_SLAB_SIZE 1024
+
+struct CallbackEntry {
+	void* cb;
+	void* arg;
+	CallbackEntry* next_free;
+	bool in_use;
+};
+
+struct CallbackSlab {
+	CallbackEntry entries[CALLBACK_SLAB_SIZE];
+	CallbackSlab* next;
+};
+
+static CallbackDispatchProc dispatcher = nullptr;
+static CallbackSlab* slabs = nullptr;
+static CallbackEntry* free_list = nullptr;
+static int live_entries = 0;
+static int slab_count = 0;
+
+static void dispatch(Fl_Widget* w, void* data) {
+	CallbackEntry* e = (CallbackEntry*)data;
+
+	if (dispatcher != nullptr && e->cb != nullptr)
+		dispatcher(e->cb, w, e->arg);
+}
+
+static void free_entry(CallbackEntry* e) {
+	e->cb = nullptr;
+	e->arg = nullptr;
+	e->in_use = false;
+	e->next_free = free_list;
+	free_list = e;
+	live_entries--;
+}
+
+static void grow() {
+	CallbackSlab* s = (CallbackSlab*)calloc(1, sizeof(CallbackSlab));
+
+	s->next = slabs;
+	slabs = s;
+	slab_count++;
+
+	for (int i = CALLBACK_SLAB_SIZE - 1; i >= 0; i--) {
+		s->entries[i].next_free = free_list;
+		free_list = &s->entries[i];
+	}
+}
+
+static CallbackEntry* alloc_entry() {
+	if (free_list == nullptr)
+		grow();
+
+	CallbackEntry* e = free_list;
+	free_list = e->next_free;
+	e->next_free = nullptr;
+	e->in_use = true;
+	live_entries++;
+	return e;
+}
+
+// Assumes nobody replaced user_data() behind the registry's back while the
+// trampoline was installed.
+static CallbackEntry* entry_of(Fl_Widget* w) {
+	if (w->callback() != dispatch)
+		return nullptr;
+
+	return (CallbackEntry*)w->user_data();
+}
+
+static void set_callback(Fl_Widget* w, void* cb, void* arg) {
+	CallbackEntry* e = entry_of(w);
+
+	if (e == nullptr) {
+		e = alloc_entry();
+		w->callback(dispatch, e);
+	}
+
+	e->cb = cb;
+	e->arg = arg;
+}
+
+extern "C" void CallbackRegistry_SetDispatcher(CallbackDispatchProc dispatch) {
+	dispatcher = dispatch;
+}
+
+extern "C" void CallbackRegistry_Set(Fl_Widget* w, void* cb, void* arg) {
+	set_callback(w, cb, arg);
+}
+
+extern "C" void CallbackRegistry_SetOwned(Fl_Widget* w, void* cb, void* arg) {
+	set_callback(w, cb, arg);
+}
+
+extern "C" void CallbackRegistry_Release(Fl_Widget* w) {
+	CallbackEntry* e = entry_of(w);
+
+	if (e == nullptr)
+		return;
+
+	w->callback(Fl_Widget::default_callback, nullptr);
+	free_entry(e);
+}
+
+// Releases w and everything inside it, or only its children: for widgets
+// about to be deleted. Their cached D proxies are dropped too.
+extern "C" void CallbackRegistry_ReleaseTree(Fl_Widget* w, int children_only) {
+	if (!children_only) {
+		CallbackRegistry_Release(w);
+		ProxyRegistry_Release(w);
+	}
+
+	Fl_Group* g = w->as_group();
+
+	if (g == nullptr)
+		return;
+
+	for (int i = 0; i < g->children(); i++)
+		CallbackRegistry_ReleaseTree(g->child(i), 0);
+}
+
+extern "C" void CallbackRegistry_Stats(int* live, int* capacity) {
+	*live = live_entries;
+	*capacity = slab_count * CALLBACK_SLAB_SIZE;
+}
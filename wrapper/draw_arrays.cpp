@@ -0,0 +1,176 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/fl_draw.H>
+#include <stdint.h>
+#include <vector>
+
+// Array versions of the fl_vertex() family, so that a polyline of n points is
+// one call from D instead of n + 2.
+//
+// The current transformation is read once (as the affine map of three
+// points), applied to the whole array in one tight loop, and the results are
+// fed to fl_transformed_vertex(), which skips the driver's own per-vertex
+// matrix multiply. The driver still gets one virtual call per point: FLTK has
+// no array primitive at the Fl_Graphics_Driver level, and talking to Xlib/GDI
+// directly would bypass the driver's HiDPI scaling and clipping.
+//
+// Rectangle lists go straight to fl_rectf()/fl_rect(), which like their
+// single-call versions ignore the transformation.
+
+enum DrawArrayType {
+	DRAW_ARRAY_INT,
+	DRAW_ARRAY_FLOAT,
+	DRAW_ARRAY_DOUBLE,
+};
+
+enum DrawArrayMode {
+	DRAW_ARRAY_POINTS,
+	DRAW_ARRAY_LINE,
+	DRAW_ARRAY_LOOP,
+	DRAW_ARRAY_POLYGON,
+	DRAW_ARRAY_COMPLEX_POLYGON,
+};
+
+static std::vector<double> transformed;
+
+static int element_size(int type) {
+	return type == DRAW_ARRAY_INT ? 4 : type == DRAW_ARRAY_FLOAT ? 4 : 8;
+}
+
+static inline double element(const unsigned char* p, int type) {
+	switch (type) {
+	case DRAW_ARRAY_INT:
+		return *(const int32_t*)p;
+	case DRAW_ARRAY_FLOAT:
+		return *(const float*)p;
+	default:
+		return *(const double*)p;
+	}
+}
+
+template<typename T>
+static void transform_points(const unsigned char* p, int count, int stride, const double* m, double* out) {
+	for (int i = 0; i < count; i++, p += stride) {
+		double x = ((const T*)p)[0];
+		double y = ((const T*)p)[1];
+
+		out[2 * i] = m[0] * x + m[2] * y + m[4];
+		out[2 * i + 1] = m[1] * x + m[3] * y + m[5];
+	}
+}
+
+// Transforms count (x, y) pairs starting at points, stride bytes apart (0 for
+// tightly packed), into the shared buffer.
+static const double* transform_array(const void* points, int count, int stride, int type) {
+	double m[6];
+	double ox = fl_transform_x(0, 0), oy = fl_transform_y(0, 0);
+
+	m[0] = fl_transform_x(1, 0) - ox;
+	m[1] = fl_transform_y(1, 0) - oy;
+	m[2] = fl_transform_x(0, 1) - ox;
+	m[3] = fl_transform_y(0, 1) - oy;
+	m[4] = ox;
+	m[5] = oy;
+
+	if (stride <= 0)
+		stride = 2 * element_size(type);
+
+	if (transformed.size() < (size_t)count * 2)
+		transformed.resize((size_t)count * 2);
+
+	const unsigned char* p = (const unsigned char*)points;
+
+	switch (type) {
+	case DRAW_ARRAY_INT:
+		transform_points<int32_t>(p, count, stride, m, transformed.data());
+		break;
+	case DRAW_ARRAY_FLOAT:
+		transform_points<float>(p, count, stride, m, transformed.data());
+		break;
+	default:
+		transform_points<double>(p, count, stride, m, transformed.data());
+		break;
+	}
+
+	return transformed.data();
+}
+
+// Draws count points as mode (DrawArrayMode). Points are (x, y) pairs of type
+// (DrawArrayType), stride bytes apart, 0 meaning tightly packed. Returns 0 for
+// an unknown type or mode.
+extern "C" int DrawArray_Vertices(const void* points, int count, int stride, int type, int mode) {
+	if (type < DRAW_ARRAY_INT || type > DRAW_ARRAY_DOUBLE || count <= 0)
+		return count == 0;
+
+	switch (mode) {
+	case DRAW_ARRAY_POINTS:
+		fl_begin_points();
+		break;
+	case DRAW_ARRAY_LINE:
+		fl_begin_line();
+		break;
+	case DRAW_ARRAY_LOOP:
+		fl_begin_loop();
+		break;
+	case DRAW_ARRAY_POLYGON:
+		fl_begin_polygon();
+		break;
+	case DRAW_ARRAY_COMPLEX_POLYGON:
+		fl_begin_complex_polygon();
+		break;
+	default:
+		return 0;
+	}
+
+	const double* xy = transform_array(points, count, stride, type);
+	const double* end = xy + 2 * (size_t)count;
+
+	for (; xy < end; xy += 2)
+		fl_transformed_vertex(xy[0], xy[1]);
+
+	switch (mode) {
+	case DRAW_ARRAY_POINTS:
+		fl_end_points();
+		break;
+	case DRAW_ARRAY_LINE:
+		fl_end_line();
+		break;
+	case DRAW_ARRAY_LOOP:
+		fl_end_loop();
+		break;
+	case DRAW_ARRAY_POLYGON:
+		fl_end_polygon();
+		break;
+	case DRAW_ARRAY_COMPLEX_POLYGON:
+		fl_end_complex_polygon();
+		break;
+	}
+
+	return 1;
+}
+
+// Draws count rectangles given as (x, y, w, h), stride bytes apart (0 for
+// tightly packed), filled or outlined in the current color.
+extern "C" int DrawArray_Rects(const void* rects, int count, int stride, int type, int filled) {
+	if (type < DRAW_ARRAY_INT || type > DRAW_ARRAY_DOUBLE)
+		return 0;
+
+	int size = element_size(type);
+	const unsigned char* p = (const unsigned char*)rects;
+
+	if (stride <= 0)
+		stride = 4 * size;
+
+	for (int i = 0; i < count; i++, p += stride) {
+		int x = (int)element(p, type);
+		int y = (int)element(p + size, type);
+		int w = (int)element(p + 2 * size, type);
+		int h = (int)element(p + 3 * size, type);
+
+		if (filled)
+			fl_rectf(x, y, w, h);
+		else
+			fl_rect(x, y, w, h);
+	}
+
+	return 1;
+}
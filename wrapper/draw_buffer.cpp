@@ -0,0 +1,154 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/fl_draw.H>
+#include <string.h>
+
+// Replays a buffer of drawing commands recorded on the D side, so a custom
+// widget's draw() crosses into C++ once per frame instead of once per
+// fl_* primitive.
+//
+// The buffer is a flat array of 32-bit words. Every command starts with its
+// opcode (DrawOp) followed by a fixed number of arguments; coordinates are
+// ints, vertices and angles are floats stored bit for bit. DRAW_TEXT carries
+// its byte count and the UTF-8 bytes padded up to a whole word. The layout
+// must stay in sync with source/fltk_d_draw.d.
+
+float draw_word_float(int w) {
+	float f;
+	memcpy(&f, &w, sizeof(f));
+	return f;
+}
+
+// Number of argument words following each fixed-size opcode.
+const int draw_op_arity[DRAW_OP_COUNT] = {
+	1, // DRAW_COLOR
+	4, // DRAW_RECTF
+	4, // DRAW_RECT
+	4, // DRAW_LINE
+	2, // DRAW_POINT
+	0, // DRAW_BEGIN_POINTS
+	0, // DRAW_BEGIN_LINE
+	0, // DRAW_BEGIN_LOOP
+	0, // DRAW_BEGIN_POLYGON
+	0, // DRAW_END_POINTS
+	0, // DRAW_END_LINE
+	0, // DRAW_END_LOOP
+	0, // DRAW_END_POLYGON
+	2, // DRAW_VERTEX
+	3, // DRAW_TEXT (plus the text itself)
+	2, // DRAW_FONT
+	2, // DRAW_LINE_STYLE
+	4, // DRAW_PUSH_CLIP
+	0, // DRAW_POP_CLIP
+	0, // DRAW_PUSH_MATRIX
+	0, // DRAW_POP_MATRIX
+	2, // DRAW_TRANSLATE
+	2, // DRAW_SCALE
+	6, // DRAW_ARC
+	6, // DRAW_PIE
+};
+
+extern "C" int DrawBuffer_Replay(const int* words, size_t count) {
+	const int* p = words;
+	const int* end = words + count;
+	int commands = 0;
+
+	while (p < end) {
+		int op = *p++;
+
+		if (op < 0 || op >= DRAW_OP_COUNT || end - p < draw_op_arity[op])
+			return -1;
+
+		const int* a = p;
+		p += draw_op_arity[op];
+
+		switch (op) {
+		case DRAW_COLOR:
+			fl_color((Fl_Color)a[0]);
+			break;
+		case DRAW_RECTF:
+			fl_rectf(a[0], a[1], a[2], a[3]);
+			break;
+		case DRAW_RECT:
+			fl_rect(a[0], a[1], a[2], a[3]);
+			break;
+		case DRAW_LINE:
+			fl_line(a[0], a[1], a[2], a[3]);
+			break;
+		case DRAW_POINT:
+			fl_point(a[0], a[1]);
+			break;
+		case DRAW_BEGIN_POINTS:
+			fl_begin_points();
+			break;
+		case DRAW_BEGIN_LINE:
+			fl_begin_line();
+			break;
+		case DRAW_BEGIN_LOOP:
+			fl_begin_loop();
+			break;
+		case DRAW_BEGIN_POLYGON:
+			fl_begin_polygon();
+			break;
+		case DRAW_END_POINTS:
+			fl_end_points();
+			break;
+		case DRAW_END_LINE:
+			fl_end_line();
+			break;
+		case DRAW_END_LOOP:
+			fl_end_loop();
+			break;
+		case DRAW_END_POLYGON:
+			fl_end_polygon();
+			break;
+		case DRAW_VERTEX:
+			fl_vertex(draw_word_float(a[0]), draw_word_float(a[1]));
+			break;
+		case DRAW_TEXT: {
+			int len = a[2];
+			int padded = (len + 3) / 4;
+
+			if (len < 0 || end - p < padded)
+				return -1;
+
+			fl_draw((const char*)p, len, a[0], a[1]);
+			p += padded;
+			break;
+		}
+		case DRAW_FONT:
+			fl_font((Fl_Font)a[0], (Fl_Fontsize)a[1]);
+			break;
+		case DRAW_LINE_STYLE:
+			fl_line_style(a[0], a[1]);
+			break;
+		case DRAW_PUSH_CLIP:
+			fl_push_clip(a[0], a[1], a[2], a[3]);
+			break;
+		case DRAW_POP_CLIP:
+			fl_pop_clip();
+			break;
+		case DRAW_PUSH_MATRIX:
+			fl_push_matrix();
+			break;
+		case DRAW_POP_MATRIX:
+			fl_pop_matrix();
+			break;
+		case DRAW_TRANSLATE:
+			fl_translate(draw_word_float(a[0]), draw_word_float(a[1]));
+			break;
+		case DRAW_SCALE:
+			fl_scale(draw_word_float(a[0]), draw_word_float(a[1]));
+			break;
+		case DRAW_ARC:
+			fl_arc(a[0], a[1], a[2], a[3], draw_word_float(a[4]), draw_word_float(a[5]));
+			break;
+		case DRAW_PIE:
+			fl_pie(a[0], a[1], a[2], a[3], draw_word_float(a[4]), draw_word_float(a[5]));
+			break;
+		}
+
+		commands++;
+	}
+
+	return commands;
+}
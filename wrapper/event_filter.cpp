@@ -0,0 +1,101 @@
+#include "fltk_d_wrapper.h"
+
+// Coalescing of high-rate events for the custom widgets (see template.cpp).
+//
+// A coalesced FL_DRAG, FL_MOVE or FL_MOUSEWHEEL is not passed to D right away:
+// its position is recorded (wheel steps are summed) and an Fl::add_check()
+// handler delivers one event per widget when the event loop has drained the
+// current batch of system events, i.e. at most once per frame. Any other event
+// for the widget, or a change of the coalesced event type, delivers the pending
+// one first, so D still sees events in order.
+//
+// The delivered event carries the latest position; Fl::event_dx()/event_dy()
+// hold the summed wheel steps, or for motion the movement since the previous
+// delivered motion event. Coalesced events are reported to FLTK as handled.
+
+static void event_flush_cb(void* data) {
+	EventFilter_Flush((PendingEvents*)data);
+}
+
+// Records the current event (evt) for later delivery. Returns the value to give
+// back from handle().
+extern "C" int EventFilter_Coalesce(PendingEvents* p, void* w, EventDeliverProc deliver, int evt) {
+	if (p->event != 0 && p->event != evt)
+		EventFilter_Flush(p);
+
+	if (p->event == 0) {
+		p->widget = w;
+		p->deliver = deliver;
+		p->event = evt;
+		p->count = 0;
+		p->dx = p->dy = 0;
+		Fl::add_check(event_flush_cb, p);
+	}
+
+	if (evt == FL_MOUSEWHEEL) {
+		p->dx += Fl::e_dx;
+		p->dy += Fl::e_dy;
+	} else if (p->has_last || p->count > 0) {
+		int from_x = p->count > 0 ? p->x : p->last_x;
+		int from_y = p->count > 0 ? p->y : p->last_y;
+
+		p->dx += Fl::e_x - from_x;
+		p->dy += Fl::e_y - from_y;
+	}
+
+	p->x = Fl::e_x;
+	p->y = Fl::e_y;
+	p->x_root = Fl::e_x_root;
+	p->y_root = Fl::e_y_root;
+	p->state = Fl::e_state;
+	p->count++;
+	return 1;
+}
+
+// Delivers the pending event, if any, with the event state it was recorded
+// with; the current event state is restored afterwards.
+extern "C" void EventFilter_Flush(PendingEvents* p) {
+	if (p->event == 0)
+		return;
+
+	int evt = p->event;
+	int saved[8] = { Fl::e_number, Fl::e_x, Fl::e_y, Fl::e_x_root, Fl::e_y_root, Fl::e_dx, Fl::e_dy, Fl::e_state };
+
+	Fl::remove_check(event_flush_cb, p);
+	p->event = 0;
+	p->delivered = p->count;
+
+	if (evt != FL_MOUSEWHEEL) {
+		p->last_x = p->x;
+		p->last_y = p->y;
+		p->has_last = true;
+	}
+
+	Fl::e_number = evt;
+	Fl::e_x = p->x;
+	Fl::e_y = p->y;
+	Fl::e_x_root = p->x_root;
+	Fl::e_y_root = p->y_root;
+	Fl::e_dx = p->dx;
+	Fl::e_dy = p->dy;
+	Fl::e_state = p->state;
+
+	p->deliver(p->widget, evt);
+
+	Fl::e_number = saved[0];
+	Fl::e_x = saved[1];
+	Fl::e_y = saved[2];
+	Fl::e_x_root = saved[3];
+	Fl::e_y_root = saved[4];
+	Fl::e_dx = saved[5];
+	Fl::e_dy = saved[6];
+	Fl::e_state = saved[7];
+}
+
+// Drops the pending event without delivering it (the widget is going away).
+extern "C" void EventFilter_Cancel(PendingEvents* p) {
+	if (p->event != 0)
+		Fl::remove_check(event_flush_cb, p);
+
+	p->event = 0;
+}
@@ -0,0 +1,641 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/Fl_Group.H>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+
+// Row, column and grid container that lays out its children only when
+// something changed.
+//
+// Fl_Pack positions every child on every draw(), and Fl_Group::resize()
+// rescales every child from its sizes() array on every resize, so a resize drag
+// over nested packs costs the whole tree per step. Flex_Grid instead:
+//
+//  - records its new geometry in resize() and only marks itself dirty; the
+//    actual layout runs once, before the next draw() or handle(), however many
+//    resize steps came in between,
+//  - moves only the children whose rectangle actually changed, so a nested
+//    Flex_Grid that kept its geometry (say, in a fixed-width column) is not
+//    visited at all,
+//  - caches its minimum size (the sum of its children's constraints, nested
+//    Flex_Grids included) until a constraint below it changes.
+//
+// Changing a constraint marks the container and its Flex_Grid ancestors dirty,
+// so a later layout only measures and positions that branch.
+//
+// In row and column mode every child is one track along the main axis: fixed
+// children keep their size (the widget's own size unless one was set), weighted
+// ones share the rest by weight, never below their min; all of them fill the
+// cross axis. In grid mode children are placed in a grid of columns, row-major
+// unless a cell was given, and the column and row tracks are sized the same way
+// (weight 1 by default).
+
+enum FlexMode {
+	FLEX_ROW,
+	FLEX_COLUMN,
+	FLEX_GRID,
+};
+
+struct FlexLayoutStats {
+	long long layouts;   // containers laid out
+	long long measures;  // containers whose minimum size was recomputed
+	long long moved;     // children given a new rectangle
+	long long kept;      // children left where they were
+};
+
+struct FlexTrack {
+	int size;
+	int min;
+	int weight;  // 0: fixed at size
+};
+
+struct FlexCell {
+	int size = -1;  // main axis size when fixed, -1 for the widget's own
+	int min = 0;
+	int weight = 0;
+	int col = -1, row = -1;  // grid position, -1 for the next free cell
+	int colspan = 1, rowspan = 1;
+	unsigned seen = 0;
+};
+
+static FlexLayoutStats stats;
+
+class Flex_Grid : public Fl_Group {
+public:
+	Flex_Grid(int x, int y, int w, int h, const char* label = 0);
+
+	void mode(int mode, int columns);
+	void spacing(int margin, int gap);
+	FlexCell& cell(Fl_Widget* w);
+	FlexTrack& track(int axis, int index);
+
+	void invalidate();
+	void layout();
+	void min_size(int* w, int* h);
+
+	void resize(int x, int y, int w, int h) override;
+	int handle(int evt) override;
+
+protected:
+	void draw() override;
+
+private:
+	bool children_changed() const;
+	bool dirty();
+	void mark_dirty();
+	void measure();
+	bool place();
+	bool place_line(bool horizontal);
+	bool place_grid();
+	void set_child(Fl_Widget* o, int X, int Y, int W, int H, bool* changed);
+
+	int _mode = FLEX_COLUMN;
+	int _columns = 1;
+	int _margin = 0;
+	int _gap = 0;
+
+	std::unordered_map<Fl_Widget*, FlexCell> _cells;
+	std::vector<FlexTrack> _tracks[2];  // grid columns, rows
+	unsigned _generation = 0;
+
+	bool _layout_dirty = true;
+	bool _measure_dirty = true;
+	std::vector<Fl_Widget*> _placed;  // the children at the last layout
+	std::vector<bool> _shown;         // and which of them were visible
+	int _min_w = 0, _min_h = 0;
+};
+
+// Scratch space shared by all layouts (they never nest: a child lays itself out
+// in its own draw()).
+static std::vector<FlexTrack> line;
+static std::vector<int> track_pos, track_size;
+
+Flex_Grid::Flex_Grid(int x, int y, int w, int h, const char* label): Fl_Group(x, y, w, h, label) {
+}
+
+// columns is only used in grid mode.
+void Flex_Grid::mode(int mode, int columns) {
+	_mode = mode;
+	_columns = columns > 0 ? columns : 1;
+	invalidate();
+}
+
+void Flex_Grid::spacing(int margin, int gap) {
+	_margin = margin;
+	_gap = gap;
+	invalidate();
+}
+
+// Constraints of child w; call invalidate() after changing them.
+FlexCell& Flex_Grid::cell(Fl_Widget* w) {
+	return _cells[w];
+}
+
+// Column (axis 0) or row (axis 1) index of the grid; call invalidate() after
+// changing it.
+FlexTrack& Flex_Grid::track(int axis, int index) {
+	std::vector<FlexTrack>& tracks = _tracks[axis ? 1 : 0];
+
+	if ((int)tracks.size() <= index)
+		tracks.resize(index + 1, FlexTrack{0, 0, 1});
+
+	return tracks[index];
+}
+
+// Constraints of this container changed: it and the Flex_Grids above it have
+// to be measured and laid out again.
+void Flex_Grid::invalidate() {
+	mark_dirty();
+	redraw();
+}
+
+void Flex_Grid::mark_dirty() {
+	_measure_dirty = _layout_dirty = true;
+
+	for (Fl_Group* p = parent(); p != nullptr; p = p->parent()) {
+		Flex_Grid* g = dynamic_cast<Flex_Grid*>(p);
+
+		if (g == nullptr || (g->_measure_dirty && g->_layout_dirty))
+			break;
+
+		g->_measure_dirty = g->_layout_dirty = true;
+	}
+}
+
+// Fl_Group has no hook for children being added, removed, shown or hidden in
+// this FLTK, so the child array and the visible bits are compared with those
+// last laid out.
+bool Flex_Grid::children_changed() const {
+	if ((size_t)children() != _placed.size() ||
+			(children() > 0 && memcmp(array(), _placed.data(), _placed.size() * sizeof(Fl_Widget*)) != 0))
+		return true;
+
+	for (int i = 0; i < children(); i++) {
+		if ((child(i)->visible() != 0) != _shown[i])
+			return true;
+	}
+
+	return false;
+}
+
+// A changed set of children counts as changed constraints.
+bool Flex_Grid::dirty() {
+	if (!_measure_dirty && children_changed())
+		mark_dirty();
+
+	return _layout_dirty;
+}
+
+void Flex_Grid::resize(int x, int y, int w, int h) {
+	if (x == this->x() && y == this->y() && w == this->w() && h == this->h())
+		return;
+
+	Fl_Widget::resize(x, y, w, h);
+	_layout_dirty = true;
+}
+
+// Lays out this container and every dirty one below it now, for callers that
+// need child positions before the next draw().
+void Flex_Grid::layout() {
+	if (dirty() && place())
+		redraw();
+
+	for (int i = 0; i < children(); i++) {
+		Flex_Grid* g = dynamic_cast<Flex_Grid*>(child(i));
+
+		if (g != nullptr)
+			g->layout();
+	}
+}
+
+void Flex_Grid::draw() {
+	// Children moved: draw all of them (without damaging the parents mid-draw).
+	if (dirty() && place())
+		clear_damage(FL_DAMAGE_ALL);
+
+	Fl_Group::draw();
+}
+
+int Flex_Grid::handle(int evt) {
+	if (dirty() && place())
+		redraw();
+
+	return Fl_Group::handle(evt);
+}
+
+// Smallest size that fits every child's constraints.
+void Flex_Grid::min_size(int* w, int* h) {
+	if (_measure_dirty || children_changed())
+		measure();
+
+	*w = _min_w;
+	*h = _min_h;
+}
+
+// Minimum size of a child that is itself a Flex_Grid, 0 x 0 for other widgets.
+static void child_min(Fl_Widget* o, int* w, int* h) {
+	Flex_Grid* g = dynamic_cast<Flex_Grid*>(o);
+
+	*w = *h = 0;
+
+	if (g != nullptr)
+		g->min_size(w, h);
+}
+
+// Splits avail pixels between tracks separated by gap: fixed tracks get their
+// size, weighted ones share the rest in proportion to their weight, but never
+// less than their min. Leaves offsets from 0 in track_pos and sizes in
+// track_size.
+static void distribute(const std::vector<FlexTrack>& tracks, int avail, int gap) {
+	size_t n = tracks.size();
+	long long weights = 0;
+	int free = avail - gap * (n > 0 ? (int)n - 1 : 0);
+
+	track_pos.resize(n);
+	track_size.resize(n);
+
+	for (size_t i = 0; i < n; i++) {
+		const FlexTrack& t = tracks[i];
+
+		if (t.weight > 0) {
+			weights += t.weight;
+			track_size[i] = -1;
+		} else {
+			track_size[i] = t.size > t.min ? t.size : t.min;
+			free -= track_size[i];
+		}
+	}
+
+	// Weighted tracks whose share is below their min get their min, and the
+	// others share what is left again.
+	for (bool again = true; again && weights > 0;) {
+		again = false;
+
+		for (size_t i = 0; i < n; i++) {
+			const FlexTrack& t = tracks[i];
+
+			if (track_size[i] < 0 && (free > 0 ? (long long)free * t.weight / weights : 0) < t.min) {
+				track_size[i] = t.min;
+				free -= t.min;
+				weights -= t.weight;
+				again = true;
+			}
+		}
+	}
+
+	if (free < 0)
+		free = 0;
+
+	// Rounded on cumulative edges so that the shares add up to free exactly.
+	long long acc = 0;
+	int edge = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		if (track_size[i] >= 0)
+			continue;
+
+		acc += (long long)free * tracks[i].weight;
+		int next = (int)(acc / weights);
+		track_size[i] = next - edge;
+		edge = next;
+	}
+
+	for (size_t i = 0, p = 0; i < n; i++) {
+		track_pos[i] = (int)p;
+		p += track_size[i] + gap;
+	}
+}
+
+// Moves (*col, *row) to the next row if a cell colspan wide doesn't fit.
+// Explicitly placed cells are not skipped.
+static void next_cell(int columns, int colspan, int* col, int* row) {
+	if (*col + colspan > columns && *col > 0) {
+		*col = 0;
+		(*row)++;
+	}
+}
+
+void Flex_Grid::measure() {
+	int n = 0, main = 0, cross = 0;
+	bool horizontal = _mode == FLEX_ROW;
+
+	stats.measures++;
+
+	if (_mode == FLEX_GRID) {
+		std::vector<int> mins[2];
+		int col = 0, row = 0;
+
+		for (int a = 0; a < 2; a++) {
+			mins[a].resize(_tracks[a].size());
+
+			for (size_t i = 0; i < _tracks[a].size(); i++)
+				mins[a][i] = _tracks[a][i].weight > 0 ? _tracks[a][i].min : _tracks[a][i].size;
+		}
+
+		for (int i = 0; i < children(); i++) {
+			Fl_Widget* o = child(i);
+			const FlexCell& c = cell(o);
+			int w, h, x, y;
+
+			if (!o->visible())
+				continue;
+
+			if (c.col >= 0 && c.row >= 0) {
+				x = c.col;
+				y = c.row;
+			} else {
+				next_cell(_columns, c.colspan, &col, &row);
+				x = col;
+				y = row;
+				col += c.colspan;
+			}
+
+			if ((int)mins[0].size() < x + c.colspan)
+				mins[0].resize(x + c.colspan, 0);
+			if ((int)mins[1].size() < y + c.rowspan)
+				mins[1].resize(y + c.rowspan, 0);
+
+			child_min(o, &w, &h);
+
+			if (c.colspan == 1 && w > mins[0][x])
+				mins[0][x] = w;
+			if (c.rowspan == 1 && h > mins[1][y])
+				mins[1][y] = h;
+		}
+
+		int total[2] = {0, 0};
+
+		for (int a = 0; a < 2; a++) {
+			for (size_t i = 0; i < mins[a].size(); i++)
+				total[a] += mins[a][i];
+
+			if (!mins[a].empty())
+				total[a] += _gap * ((int)mins[a].size() - 1);
+		}
+
+		_min_w = total[0] + 2 * _margin;
+		_min_h = total[1] + 2 * _margin;
+		_measure_dirty = false;
+		return;
+	}
+
+	for (int i = 0; i < children(); i++) {
+		Fl_Widget* o = child(i);
+		const FlexCell& c = cell(o);
+		int w, h;
+
+		if (!o->visible())
+			continue;
+
+		child_min(o, &w, &h);
+
+		int own = horizontal ? w : h;
+
+		if (c.weight > 0)
+			main += c.min > own ? c.min : own;
+		else
+			main += c.size >= 0 ? c.size : horizontal ? o->w() : o->h();
+
+		if ((horizontal ? h : w) > cross)
+			cross = horizontal ? h : w;
+
+		n++;
+	}
+
+	main += 2 * _margin + (n > 0 ? _gap * (n - 1) : 0);
+	cross += 2 * _margin;
+
+	_min_w = horizontal ? main : cross;
+	_min_h = horizontal ? cross : main;
+	_measure_dirty = false;
+}
+
+void Flex_Grid::set_child(Fl_Widget* o, int X, int Y, int W, int H, bool* changed) {
+	if (W < 0)
+		W = 0;
+	if (H < 0)
+		H = 0;
+
+	if (o->x() == X && o->y() == Y && o->w() == W && o->h() == H) {
+		stats.kept++;
+		return;
+	}
+
+	o->resize(X, Y, W, H);
+	stats.moved++;
+	*changed = true;
+}
+
+// Returns whether any child was moved.
+bool Flex_Grid::place() {
+	bool changed;
+
+	stats.layouts++;
+	_generation++;
+
+	if (_measure_dirty || children_changed())
+		measure();
+
+	if (_mode == FLEX_GRID)
+		changed = place_grid();
+	else
+		changed = place_line(_mode == FLEX_ROW);
+
+	_layout_dirty = false;
+	_placed.assign(array(), array() + children());
+	_shown.resize(children());
+
+	for (int i = 0; i < children(); i++)
+		_shown[i] = child(i)->visible() != 0;
+
+	// Drop the constraints of children that are gone.
+	if (_cells.size() > (size_t)children()) {
+		for (auto it = _cells.begin(); it != _cells.end();) {
+			if (it->second.seen != _generation)
+				it = _cells.erase(it);
+			else
+				++it;
+		}
+	}
+
+	return changed;
+}
+
+bool Flex_Grid::place_line(bool horizontal) {
+	int X = x() + _margin, Y = y() + _margin;
+	int W = w() - 2 * _margin, H = h() - 2 * _margin;
+	bool changed = false;
+
+	line.clear();
+
+	for (int i = 0; i < children(); i++) {
+		Fl_Widget* o = child(i);
+		FlexCell& c = cell(o);
+		int w, h;
+
+		c.seen = _generation;
+
+		if (!o->visible())
+			continue;
+
+		child_min(o, &w, &h);
+
+		int own = horizontal ? w : h;
+		FlexTrack t;
+
+		t.size = c.size >= 0 ? c.size : horizontal ? o->w() : o->h();
+		t.min = c.min > own ? c.min : own;
+		t.weight = c.weight;
+		line.push_back(t);
+	}
+
+	distribute(line, horizontal ? W : H, _gap);
+
+	for (int i = 0, k = 0; i < children(); i++) {
+		Fl_Widget* o = child(i);
+
+		if (!o->visible())
+			continue;
+
+		if (horizontal)
+			set_child(o, X + track_pos[k], Y, track_size[k], H, &changed);
+		else
+			set_child(o, X, Y + track_pos[k], W, track_size[k], &changed);
+
+		k++;
+	}
+
+	return changed;
+}
+
+bool Flex_Grid::place_grid() {
+	int X = x() + _margin, Y = y() + _margin;
+	int W = w() - 2 * _margin, H = h() - 2 * _margin;
+	bool changed = false;
+	int col = 0, row = 0;
+	std::vector<int> cells;  // col, row per visible child
+	std::vector<FlexTrack> tracks[2] = {_tracks[0], _tracks[1]};
+
+	if ((int)tracks[0].size() < _columns)
+		tracks[0].resize(_columns, FlexTrack{0, 0, 1});
+
+	for (int i = 0; i < children(); i++) {
+		Fl_Widget* o = child(i);
+		FlexCell& c = cell(o);
+		int w, h, cx, cy;
+
+		c.seen = _generation;
+
+		if (!o->visible())
+			continue;
+
+		if (c.col >= 0 && c.row >= 0) {
+			cx = c.col;
+			cy = c.row;
+		} else {
+			next_cell(_columns, c.colspan, &col, &row);
+			cx = col;
+			cy = row;
+			col += c.colspan;
+		}
+
+		cells.push_back(cx);
+		cells.push_back(cy);
+
+		if ((int)tracks[0].size() < cx + c.colspan)
+			tracks[0].resize(cx + c.colspan, FlexTrack{0, 0, 1});
+		if ((int)tracks[1].size() < cy + c.rowspan)
+			tracks[1].resize(cy + c.rowspan, FlexTrack{0, 0, 1});
+
+		child_min(o, &w, &h);
+
+		if (c.colspan == 1 && w > tracks[0][cx].min)
+			tracks[0][cx].min = w;
+		if (c.rowspan == 1 && h > tracks[1][cy].min)
+			tracks[1][cy].min = h;
+	}
+
+	distribute(tracks[0], W, _gap);
+	std::vector<int> col_pos = track_pos, col_size = track_size;
+	distribute(tracks[1], H, _gap);
+
+	for (int i = 0, k = 0; i < children(); i++) {
+		Fl_Widget* o = child(i);
+
+		if (!o->visible())
+			continue;
+
+		const FlexCell& c = cell(o);
+		int cx = cells[2 * k], cy = cells[2 * k + 1];
+		int last_col = cx + c.colspan - 1, last_row = cy + c.rowspan - 1;
+
+		set_child(o, X + col_pos[cx], Y + track_pos[cy],
+			col_pos[last_col] + col_size[last_col] - col_pos[cx],
+			track_pos[last_row] + track_size[last_row] - track_pos[cy], &changed);
+		k++;
+	}
+
+	return changed;
+}
+
+extern "C" Flex_Grid* FlexLayout_Create(int x, int y, int w, int h, const char* label = 0) {
+	return new Flex_Grid(x, y, w, h, label);
+}
+
+extern "C" void FlexLayout_SetMode(Flex_Grid* f, int mode, int columns) {
+	f->mode(mode, columns);
+}
+
+extern "C" void FlexLayout_SetSpacing(Flex_Grid* f, int margin, int gap) {
+	f->spacing(margin, gap);
+}
+
+// Main axis constraint of child w: size -1 keeps the widget's own size, weight
+// > 0 shares the free space instead.
+extern "C" void FlexLayout_SetCell(Flex_Grid* f, Fl_Widget* w, int size, int min, int weight) {
+	FlexCell& c = f->cell(w);
+
+	c.size = size;
+	c.min = min;
+	c.weight = weight;
+	f->invalidate();
+}
+
+// Grid position of child w; col = row = -1 for the next free cell.
+extern "C" void FlexLayout_SetGridCell(Flex_Grid* f, Fl_Widget* w, int col, int row, int colspan, int rowspan) {
+	FlexCell& c = f->cell(w);
+
+	c.col = col;
+	c.row = row;
+	c.colspan = colspan > 0 ? colspan : 1;
+	c.rowspan = rowspan > 0 ? rowspan : 1;
+	f->invalidate();
+}
+
+extern "C" void FlexLayout_SetTrack(Flex_Grid* f, int axis, int index, int size, int min, int weight) {
+	FlexTrack& t = f->track(axis, index);
+
+	t.size = size;
+	t.min = min;
+	t.weight = weight;
+	f->invalidate();
+}
+
+extern "C" void FlexLayout_Invalidate(Flex_Grid* f) {
+	f->invalidate();
+}
+
+extern "C" void FlexLayout_Layout(Flex_Grid* f) {
+	f->layout();
+}
+
+extern "C" void FlexLayout_MinSize(Flex_Grid* f, int* w, int* h) {
+	f->min_size(w, h);
+}
+
+extern "C" void FlexLayout_Stats(FlexLayoutStats* out, int reset) {
+	*out = stats;
+
+	if (reset)
+		stats = FlexLayoutStats{};
+}
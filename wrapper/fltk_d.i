@@ -29,11 +29,38 @@
 	#include <Fl/Fl_Light_Button.H>
 	#include <Fl/Fl_Check_Button.H>
 	#include <Fl/Fl_Native_File_Chooser.H>
+	#include <Fl/Fl_Simple_Terminal.H>
+	#include <Fl/Fl_Table.H>
+	#include <Fl/Fl_Table_Row.H>
+	#include <Fl/Fl_Tree_Prefs.H>
+	#include <Fl/Fl_Tree_Item_Array.H>
+	#include <Fl/Fl_Tree_Item.H>
+	#include <Fl/Fl_Tree.H>
 	#include "/Shine/Libs/FLTKExtraWidgets/include/Widgets.h"
+	#include "fltk_d_wrapper.h"
 %}
 
 %rename("%(strip:[Fl_])s") "";
 
+// Widgets returned by getters (parent(), child(), window(), Fl::focus(), ...)
+// are looked up in the proxy cache (source/fltk_d_proxy.d) instead of getting
+// a new D object on every call.
+%pragma(d) moduleimports=%{
+static import fltk_d_proxy;
+%}
+
+%typemap(dout, excode=SWIGEXCODE) Fl_Widget*, Fl_Group*, Fl_Window*, Fl_Double_Window* {
+	void* cPtr = $imcall;$excode
+	return fltk_d_proxy.cachedProxy!($dclassname)(cPtr);
+}
+
+// A widget deleted by the proxy that owns it (dispose, or the GC collecting
+// the proxy) gives back the callback entries and proxy cache entries of its
+// whole tree first, like DeleteWidget() does (see callback_registry.cpp).
+// The unref feature is inherited, so this replaces the delete in every
+// widget's destructor wrapper.
+%feature("unref") Fl_Widget "CallbackRegistry_ReleaseTree($this, 0); delete $this;"
+
 %include "../headers_to_translate/FL/Fl.H"
 %include "../headers_to_translate/FL/Fl_Widget.H"
 %include "../headers_to_translate/FL/Fl_Button.H"
@@ -62,4 +89,11 @@
 %include "../headers_to_translate/FL/Fl_Light_Button.H"
 %include "../headers_to_translate/FL/Fl_Check_Button.H"
 %include "../headers_to_translate/FL/Fl_Native_File_Chooser.H"
+%include "../headers_to_translate/FL/Fl_Simple_Terminal.H"
+%include "../headers_to_translate/FL/Fl_Table.H"
+%include "../headers_to_translate/FL/Fl_Table_Row.H"
+%include "../headers_to_translate/FL/Fl_Tree_Prefs.H"
+%include "../headers_to_translate/FL/Fl_Tree_Item_Array.H"
+%include "../headers_to_translate/FL/Fl_Tree_Item.H"
+%include "../headers_to_translate/FL/Fl_Tree.H"
 %include "/Shine/Libs/FLTKExtraWidgets/include/Widgets.h"
\ No newline at end of file
@@ -0,0 +1,180 @@
+#ifndef FLTK_D_WRAPPER_H
+#define FLTK_D_WRAPPER_H
+
+// Declarations shared between the hand-written wrapper sources and the
+// generated custom widgets (libcustomwidgets.cxx).
+
+#include <Fl/Fl.H>
+#include <Fl/Fl_Widget.H>
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+// Layout of a D dynamic array (const(char)[]).
+struct DSlice {
+	size_t length;
+	const char* ptr;
+};
+
+// awake_post.cpp
+struct AwakePost {
+	Fl_Awake_Handler handler;
+	void* data;
+	std::atomic<bool> pending{false};
+};
+
+void awake_post(AwakePost& post);
+void awake_drained(AwakePost& post);
+
+// callback_registry.cpp
+typedef void (*CallbackDispatchProc)(void* cb, Fl_Widget* w, void* arg);
+
+extern "C" void CallbackRegistry_SetDispatcher(CallbackDispatchProc dispatch);
+extern "C" void CallbackRegistry_Set(Fl_Widget* w, void* cb, void* arg);
+extern "C" void CallbackRegistry_SetOwned(Fl_Widget* w, void* cb, void* arg);
+extern "C" void CallbackRegistry_Release(Fl_Widget* w);
+extern "C" void CallbackRegistry_ReleaseTree(Fl_Widget* w, int children_only);
+extern "C" void CallbackRegistry_Stats(int* live, int* capacity);
+
+// proxy_registry.cpp
+typedef void (*ProxyReleaseProc)(Fl_Widget* w);
+
+extern "C" void ProxyRegistry_SetReleaseHook(ProxyReleaseProc hook);
+extern "C" void ProxyRegistry_Track(Fl_Widget* w);
+extern "C" int ProxyRegistry_Tracked(Fl_Widget* w);
+extern "C" void ProxyRegistry_Untrack(Fl_Widget* w);
+extern "C" void ProxyRegistry_Release(Fl_Widget* w);
+extern "C" void ProxyRegistry_Stats(int* live);
+
+// draw_buffer.cpp
+enum DrawOp {
+	DRAW_COLOR,
+	DRAW_RECTF,
+	DRAW_RECT,
+	DRAW_LINE,
+	DRAW_POINT,
+	DRAW_BEGIN_POINTS,
+	DRAW_BEGIN_LINE,
+	DRAW_BEGIN_LOOP,
+	DRAW_BEGIN_POLYGON,
+	DRAW_END_POINTS,
+	DRAW_END_LINE,
+	DRAW_END_LOOP,
+	DRAW_END_POLYGON,
+	DRAW_VERTEX,
+	DRAW_TEXT,
+	DRAW_FONT,
+	DRAW_LINE_STYLE,
+	DRAW_PUSH_CLIP,
+	DRAW_POP_CLIP,
+	DRAW_PUSH_MATRIX,
+	DRAW_POP_MATRIX,
+	DRAW_TRANSLATE,
+	DRAW_SCALE,
+	DRAW_ARC,
+	DRAW_PIE,
+	DRAW_OP_COUNT
+};
+
+extern const int draw_op_arity[DRAW_OP_COUNT];
+
+// The float argument stored bit for bit in a word.
+float draw_word_float(int w);
+
+extern "C" int DrawBuffer_Replay(const int* words, size_t count);
+
+// text_buffer.cpp
+class Fl_Text_Buffer;
+
+extern "C" void TextBuffer_Reserve(Fl_Text_Buffer* b, int extra);
+extern "C" void TextBuffer_Insert(Fl_Text_Buffer* b, int pos, const char* text, int len);
+extern "C" void TextBuffer_Append(Fl_Text_Buffer* b, const char* text, int len);
+extern "C" void TextBuffer_AppendSlices(Fl_Text_Buffer* b, const DSlice* slices, size_t count);
+extern "C" void TextBuffer_Replace(Fl_Text_Buffer* b, int start, int end, const char* text, int len);
+extern "C" void TextBuffer_Slices(Fl_Text_Buffer* b, int start, int end,
+		const char** first, int* first_len, const char** second, int* second_len);
+
+// event_filter.cpp
+#define EVENT_BIT(evt) ((evt) >= 0 && (evt) < 64 ? (uint64_t)1 << (evt) : 0)
+
+typedef int (*EventDeliverProc)(void* w, int evt);
+
+// Motion/wheel events of one widget waiting for their once-per-frame delivery.
+struct PendingEvents {
+	void* widget;
+	EventDeliverProc deliver;
+	int event;  // 0 if nothing is pending
+	int count;
+	int x, y, x_root, y_root, state;
+	int dx, dy;
+	int last_x, last_y;  // position of the last delivered motion event
+	bool has_last;
+	int delivered;       // events merged into the last delivery
+};
+
+extern "C" int EventFilter_Coalesce(PendingEvents* p, void* w, EventDeliverProc deliver, int evt);
+extern "C" void EventFilter_Flush(PendingEvents* p);
+extern "C" void EventFilter_Cancel(PendingEvents* p);
+
+// retained_surface.cpp
+class Fl_Image_Surface;
+
+struct RetainedSurface {
+	Fl_Image_Surface* surface;
+	int w, h;
+	bool valid;
+	long long renders;
+	long long blits;
+};
+
+extern "C" void RetainedSurface_Draw(RetainedSurface* r, Fl_Widget* w, bool* rendering);
+extern "C" void RetainedSurface_Invalidate(RetainedSurface* r);
+extern "C" void RetainedSurface_Free(RetainedSurface* r);
+
+// async_raster.cpp
+struct AsyncRaster;
+
+struct AsyncRasterStats {
+	long long submitted;
+	long long rendered;
+	long long dropped;       // frames replaced before they were rendered or shown
+	long long blits;
+	double last_render_ms;   // worker time: what draw() would block for synchronously
+	double max_render_ms;
+	double last_draw_ms;     // main thread time in draw(): what input waits for now
+	double max_draw_ms;
+	double last_latency_ms;  // submit to first blit of a frame
+};
+
+extern "C" AsyncRaster* AsyncRaster_Create(Fl_Widget* w);
+extern "C" void AsyncRaster_Submit(AsyncRaster* r, Fl_Widget* w, const int* words, size_t count);
+extern "C" void AsyncRaster_Draw(AsyncRaster* r, Fl_Widget* w);
+extern "C" void AsyncRaster_Free(AsyncRaster* r);
+extern "C" void AsyncRaster_Stats(AsyncRaster* r, AsyncRasterStats* stats);
+
+// virtual_list.cpp
+// Heights of n items with their prefix sums in a Fenwick tree: the offset of an
+// item, the item at an offset and changing one height are all O(log n).
+class HeightIndex {
+public:
+	void assign(int n, int height);
+	void resize(int n, int height);  // keeps the first heights, new items get height
+	void set(int index, int height);
+
+	int count() const { return _count; }
+	int height(int index) const { return _height[index]; }
+	long long offset(int index) const;  // sum of the heights before index
+	int item_at(long long offset) const;
+	long long total() const { return offset(_count); }
+
+private:
+	void push(int height);
+
+	int _count = 0;
+	std::vector<int> _height;
+	std::vector<long long> _tree;  // 1-based
+	int _mask = 1;                 // highest power of two <= _count (at least 1)
+};
+
+#endif
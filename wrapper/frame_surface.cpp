@@ -0,0 +1,332 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/Fl_Image.H>
+#include <Fl/fl_draw.H>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <chrono>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FRAME_SURFACE_X86 1
+#include <immintrin.h>
+#endif
+
+// Video/plot frames from caller-owned pixel buffers, drawn through one
+// long-lived Fl_RGB_Image.
+//
+// Layouts FLTK draws natively (RGB, RGBA, 8-bit gray) are not copied at all:
+// the image points at the caller's buffer, which must stay valid until the
+// next update. Everything else is converted into a buffer owned by the surface.
+// Either way the image object is reused and only uncache()d, so its cached
+// pixmap is rebuilt without reallocating the image per frame.
+//
+// The channel swizzle and 16-bit gray kernels have SSSE3 and AVX2 versions
+// picked at runtime; premultiplied alpha and YUV go through scalar
+// fixed-point code.
+
+enum FrameFormat {
+	FRAME_RGB24,
+	FRAME_RGBA32,
+	FRAME_BGRA32,
+	FRAME_RGBA32_PREMUL,
+	FRAME_BGRA32_PREMUL,
+	FRAME_GRAY8,
+	FRAME_GRAY16,
+	FRAME_I420,
+	FRAME_NV12,
+};
+
+struct FrameSurfaceStats {
+	long long frames;
+	long long copied_frames;
+	double last_convert_ms;
+	double total_convert_ms;
+};
+
+struct FrameSurface {
+	Fl_RGB_Image* image;
+	uchar* pixels;
+	size_t pixels_size;
+	FrameSurfaceStats stats;
+};
+
+typedef void (*SwizzleRowProc)(const uchar* src, uchar* dst, int n);
+typedef void (*Gray16RowProc)(const uint16_t* src, uchar* dst, int n);
+
+static void swizzle_row_scalar(const uchar* src, uchar* dst, int n) {
+	for (int i = 0; i < n; i++, src += 4, dst += 4) {
+		uchar b = src[0];
+		dst[0] = src[2];
+		dst[1] = src[1];
+		dst[2] = b;
+		dst[3] = src[3];
+	}
+}
+
+static void gray16_row_scalar(const uint16_t* src, uchar* dst, int n) {
+	for (int i = 0; i < n; i++)
+		dst[i] = (uchar)(src[i] >> 8);
+}
+
+#ifdef FRAME_SURFACE_X86
+
+__attribute__((target("ssse3")))
+static void swizzle_row_ssse3(const uchar* src, uchar* dst, int n) {
+	const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	int i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + i * 4));
+		_mm_storeu_si128((__m128i*)(dst + i * 4), _mm_shuffle_epi8(v, mask));
+	}
+
+	swizzle_row_scalar(src + i * 4, dst + i * 4, n - i);
+}
+
+__attribute__((target("avx2")))
+static void swizzle_row_avx2(const uchar* src, uchar* dst, int n) {
+	const __m256i mask = _mm256_setr_epi8(
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	int i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+		_mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_shuffle_epi8(v, mask));
+	}
+
+	swizzle_row_scalar(src + i * 4, dst + i * 4, n - i);
+}
+
+__attribute__((target("sse2")))
+static void gray16_row_sse2(const uint16_t* src, uchar* dst, int n) {
+	int i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i a = _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(src + i)), 8);
+		__m128i b = _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(src + i + 8)), 8);
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+	}
+
+	gray16_row_scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void gray16_row_avx2(const uint16_t* src, uchar* dst, int n) {
+	int i = 0;
+
+	for (; i + 32 <= n; i += 32) {
+		__m256i a = _mm256_srli_epi16(_mm256_loadu_si256((const __m256i*)(src + i)), 8);
+		__m256i b = _mm256_srli_epi16(_mm256_loadu_si256((const __m256i*)(src + i + 16)), 8);
+		// packus works per 128-bit lane; put the quarters back in order.
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+		_mm256_storeu_si256((__m256i*)(dst + i), packed);
+	}
+
+	gray16_row_scalar(src + i, dst + i, n - i);
+}
+
+#endif
+
+static SwizzleRowProc swizzle_row = nullptr;
+static Gray16RowProc gray16_row = nullptr;
+
+static void select_kernels() {
+	if (swizzle_row != nullptr)
+		return;
+
+	swizzle_row = swizzle_row_scalar;
+	gray16_row = gray16_row_scalar;
+
+#ifdef FRAME_SURFACE_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("sse2"))
+		gray16_row = gray16_row_sse2;
+
+	if (__builtin_cpu_supports("ssse3"))
+		swizzle_row = swizzle_row_ssse3;
+
+	if (__builtin_cpu_supports("avx2")) {
+		swizzle_row = swizzle_row_avx2;
+		gray16_row = gray16_row_avx2;
+	}
+#endif
+}
+
+// unpremultiply[a][c] would be 64 KiB; a per-alpha reciprocal is enough.
+static unsigned unpremultiply_scale[256];
+
+static void unpremultiply_row(const uchar* src, uchar* dst, int n, bool bgra) {
+	if (unpremultiply_scale[1] == 0) {
+		for (int a = 1; a < 256; a++)
+			unpremultiply_scale[a] = (255u * 65536u + a / 2) / a;
+	}
+
+	int r = bgra ? 2 : 0, b = bgra ? 0 : 2;
+
+	for (int i = 0; i < n; i++, src += 4, dst += 4) {
+		unsigned a = src[3];
+		unsigned s = unpremultiply_scale[a];
+		unsigned cr = (src[r] * s) >> 16, cg = (src[1] * s) >> 16, cb = (src[b] * s) >> 16;
+
+		dst[0] = (uchar)(cr > 255 ? 255 : cr);
+		dst[1] = (uchar)(cg > 255 ? 255 : cg);
+		dst[2] = (uchar)(cb > 255 ? 255 : cb);
+		dst[3] = (uchar)a;
+	}
+}
+
+static inline uchar clamp_byte(int v) {
+	return (uchar)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+// BT.601 limited range, 16.16 fixed point. chroma_step is 1 for planar U/V
+// rows and 2 for NV12's interleaved UV row.
+static void yuv_row(const uchar* y, const uchar* u, const uchar* v, int chroma_step, uchar* dst, int n) {
+	for (int i = 0; i < n; i++, dst += 3) {
+		int c = (y[i] - 16) * 76309;
+		int d = u[(i / 2) * chroma_step] - 128;
+		int e = v[(i / 2) * chroma_step] - 128;
+
+		dst[0] = clamp_byte((c + 104597 * e + 32768) >> 16);
+		dst[1] = clamp_byte((c - 25675 * d - 53279 * e + 32768) >> 16);
+		dst[2] = clamp_byte((c + 132201 * d + 32768) >> 16);
+	}
+}
+
+static int frame_depth(int format) {
+	switch (format) {
+	case FRAME_RGB24:
+	case FRAME_I420:
+	case FRAME_NV12:
+		return 3;
+	case FRAME_GRAY8:
+	case FRAME_GRAY16:
+		return 1;
+	default:
+		return 4;
+	}
+}
+
+// Points the surface's image at pixels, creating a new image object only when
+// the geometry changes.
+static void frame_attach(FrameSurface* s, const uchar* pixels, int w, int h, int d, int ld) {
+	Fl_RGB_Image* img = s->image;
+
+	if (img == nullptr || img->w() != w || img->h() != h || img->d() != d || img->ld() != ld) {
+		delete img;
+		s->image = new Fl_RGB_Image(pixels, w, h, d, ld);
+		return;
+	}
+
+	img->array = pixels;
+	img->uncache();
+}
+
+static uchar* frame_buffer(FrameSurface* s, size_t size) {
+	if (s->pixels_size < size) {
+		free(s->pixels);
+		s->pixels = (uchar*)malloc(size);
+		s->pixels_size = size;
+	}
+
+	return s->pixels;
+}
+
+extern "C" FrameSurface* FrameSurface_Create() {
+	select_kernels();
+
+	FrameSurface* s = (FrameSurface*)calloc(1, sizeof(FrameSurface));
+	return s;
+}
+
+extern "C" void FrameSurface_Destroy(FrameSurface* s) {
+	delete s->image;
+	free(s->pixels);
+	free(s);
+}
+
+// stride is the source row length in bytes (0 for tightly packed). Planar YUV
+// expects its chroma planes right after the luma plane, at half the stride
+// rounded up.
+// Returns 0 for an unknown format.
+extern "C" int FrameSurface_Update(FrameSurface* s, const void* data, int w, int h, int stride, int format) {
+	const uchar* src = (const uchar*)data;
+	int d = frame_depth(format);
+	auto start = std::chrono::steady_clock::now();
+
+	if (w <= 0 || h <= 0 || format < FRAME_RGB24 || format > FRAME_NV12)
+		return 0;
+
+	if (stride <= 0)
+		stride = format == FRAME_GRAY16 ? w * 2 : format >= FRAME_I420 ? w : w * d;
+
+	switch (format) {
+	case FRAME_RGB24:
+	case FRAME_RGBA32:
+	case FRAME_GRAY8:
+		frame_attach(s, src, w, h, d, stride == w * d ? 0 : stride);
+		s->stats.frames++;
+		return 1;
+	default:
+		break;
+	}
+
+	uchar* dst = frame_buffer(s, (size_t)w * h * d);
+
+	for (int y = 0; y < h; y++) {
+		const uchar* row = src + (size_t)y * stride;
+		uchar* out = dst + (size_t)y * w * d;
+
+		switch (format) {
+		case FRAME_BGRA32:
+			swizzle_row(row, out, w);
+			break;
+		case FRAME_RGBA32_PREMUL:
+			unpremultiply_row(row, out, w, false);
+			break;
+		case FRAME_BGRA32_PREMUL:
+			unpremultiply_row(row, out, w, true);
+			break;
+		case FRAME_GRAY16:
+			gray16_row((const uint16_t*)row, out, w);
+			break;
+		case FRAME_I420: {
+			const uchar* u = src + (size_t)stride * h;
+			const uchar* v = u + (size_t)((stride + 1) / 2) * ((h + 1) / 2);
+			size_t offset = (size_t)(y / 2) * ((stride + 1) / 2);
+			yuv_row(row, u + offset, v + offset, 1, out, w);
+			break;
+		}
+		case FRAME_NV12: {
+			const uchar* uv = src + (size_t)stride * h + (size_t)(y / 2) * stride;
+			yuv_row(row, uv, uv + 1, 2, out, w);
+			break;
+		}
+		}
+	}
+
+	frame_attach(s, dst, w, h, d, 0);
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	s->stats.frames++;
+	s->stats.copied_frames++;
+	s->stats.last_convert_ms = ms;
+	s->stats.total_convert_ms += ms;
+	return 1;
+}
+
+extern "C" Fl_RGB_Image* FrameSurface_Image(FrameSurface* s) {
+	return s->image;
+}
+
+extern "C" void FrameSurface_Draw(FrameSurface* s, int x, int y) {
+	if (s->image != nullptr)
+		s->image->draw(x, y);
+}
+
+extern "C" void FrameSurface_Stats(FrameSurface* s, FrameSurfaceStats* stats) {
+	*stats = s->stats;
+}
@@ -8,7 +8,18 @@ alias C_Custom!WIDGET_NAME!=void*;
 extern(C){
     C_Custom!WIDGET_NAME! Custom!WIDGET_NAME!_Create(int x, int y, int w, int h, const char* label = null);
     void Custom!WIDGET_NAME!_SetHandle(C_Custom!WIDGET_NAME! w, HandleProc h);
+    void Custom!WIDGET_NAME!_SetEventMask(C_Custom!WIDGET_NAME! w, ulong mask, ulong coalesce);
+    int  Custom!WIDGET_NAME!_CoalescedCount(C_Custom!WIDGET_NAME! w);
     void Custom!WIDGET_NAME!_SetDraw(C_Custom!WIDGET_NAME! w, DrawProc d);
+    void Custom!WIDGET_NAME!_SetDrawEx(C_Custom!WIDGET_NAME! w, DrawExProc d);
+    void Custom!WIDGET_NAME!_SetDrawBuffer(C_Custom!WIDGET_NAME! w, const(int)* words, size_t count);
+    void Custom!WIDGET_NAME!_SetRetained(C_Custom!WIDGET_NAME! w, int retained);
+    void Custom!WIDGET_NAME!_Invalidate(C_Custom!WIDGET_NAME! w);
+    void Custom!WIDGET_NAME!_RetainedStats(C_Custom!WIDGET_NAME! w, long* renders, long* blits);
+    void Custom!WIDGET_NAME!_SetAsync(C_Custom!WIDGET_NAME! w, int async);
+    void Custom!WIDGET_NAME!_SubmitFrame(C_Custom!WIDGET_NAME! w, const(int)* words, size_t count);
+    void Custom!WIDGET_NAME!_AsyncStats(C_Custom!WIDGET_NAME! w, AsyncRasterStats* stats);
+    void Custom!WIDGET_NAME!_SetCallback(C_Custom!WIDGET_NAME! w, void* cb, void* arg);
     void Custom!WIDGET_NAME!_RealDraw(C_Custom!WIDGET_NAME! w);
     int  Custom!WIDGET_NAME!_RealHandle(C_Custom!WIDGET_NAME! w, int evt);
 }
@@ -35,15 +46,32 @@ widgets=[
 	"Choice",
 	"Check_Button",
 	"Light_Button",
+	"Table",
+	"Table_Row",
+	"Tree",
 ]
 
 head="\n".join(lines[0:body_position])
 body="\n".join(lines[body_position:])
 
-cpp_out=""
+cpp_out=head+"\n"
 d_out="""
 alias HandleProc = extern (C) int function(void* w, int evt);
 alias DrawProc = extern (C) void function(void* w);
+alias DrawExProc = extern (C) void function(void* widget, int damage, int x, int y, int w, int h);
+
+// Must match struct AsyncRasterStats in wrapper/fltk_d_wrapper.h
+struct AsyncRasterStats {
+    long submitted;
+    long rendered;
+    long dropped;
+    long blits;
+    double last_render_ms;
+    double max_render_ms;
+    double last_draw_ms;
+    double max_draw_ms;
+    double last_latency_ms;
+}
 """
 
 for w in widgets:
@@ -0,0 +1,454 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/Fl_Image.H>
+#include <Fl/Fl_PNG_Image.H>
+#include <Fl/Fl_JPEG_Image.H>
+#include <Fl/Fl_BMP_Image.H>
+#include <Fl/Fl_SVG_Image.H>
+#include <Fl/fl_utf8.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Image cache with a byte budget and background decoding.
+//
+// Unlike Fl_Shared_Image, which keeps every image it ever loaded and decodes it
+// on the calling (UI) thread, entries here are keyed on (path, size), decoded
+// or scaled on a small worker pool, and evicted least recently used first once
+// the decoded pixels exceed the budget. Entries that are pinned with
+// ImageCache_Acquire(), or still being decoded, are never evicted.
+//
+// Until an entry is ready the placeholder image (if any) is returned, and the
+// widget that asked for it is redrawn when the pixels arrive. Each requested
+// size is its own entry, produced once with copy(w, h) from the full-size image
+// (or by rasterizing SVGs at that size) rather than on every draw.
+//
+// Workers only construct images; everything that may touch the graphics driver
+// (drawing, deleting) stays on the main thread. Finished jobs are handed back
+// through awake_post().
+//
+// Decoded formats: PNG, JPEG, BMP and SVG.
+
+#define IMAGE_CACHE_DEFAULT_BUDGET (256u << 20)
+
+enum CachedImageState {
+	IMAGE_PENDING,
+	IMAGE_READY,
+	IMAGE_FAILED,
+};
+
+enum ImageFileKind {
+	IMAGE_FILE_UNKNOWN,
+	IMAGE_FILE_PNG,
+	IMAGE_FILE_JPEG,
+	IMAGE_FILE_BMP,
+	IMAGE_FILE_SVG,
+};
+
+struct ImageCacheStats {
+	long long hits;
+	long long misses;
+	long long decoded;
+	long long scaled;
+	long long failed;
+	long long evictions;
+	long long bytes;
+	long long budget;
+	int entries;
+	int pending;
+};
+
+struct CachedImage {
+	std::string path;
+	int w, h;  // 0 for the image's own size
+	int state;
+	int refs;
+	size_t bytes;
+	Fl_Image* image;
+	Fl_Image* result;  // written by the worker, picked up on the main thread
+	bool in_lru;
+	std::list<CachedImage*>::iterator lru;
+	std::list<Fl_Widget*> waiters;        // watched with Fl::watch_widget_pointer
+	std::vector<CachedImage*> dependents; // sized entries waiting for this one
+	CachedImage* source;                  // pinned while this one is copied from it
+};
+
+struct ImageJob {
+	CachedImage* entry;
+	Fl_Image* source;  // copy(w, h) of this, or decode entry->path if null
+};
+
+struct ImageCache {
+	std::unordered_map<std::string, std::unique_ptr<CachedImage>> entries;
+	std::list<CachedImage*> lru;  // most recently used first; ready or failed entries only
+	size_t bytes = 0;
+	size_t budget = IMAGE_CACHE_DEFAULT_BUDGET;
+	Fl_Image* placeholder = nullptr;
+	int pending = 0;
+	ImageCacheStats stats = {};
+
+	std::mutex lock;
+	std::condition_variable wake;
+	std::deque<ImageJob> jobs;
+	std::vector<CachedImage*> done;
+	int workers = 0;
+	int max_workers = 0;
+};
+
+static void image_jobs_done(void*);
+
+// Never destroyed: detached workers may still be waiting on it at exit.
+static ImageCache& cache = *new ImageCache();
+static AwakePost& jobs_done = *new AwakePost{ image_jobs_done, nullptr };
+
+static std::string image_key(const char* path, int w, int h) {
+	std::string key(path);
+	key += '\n';
+	key += std::to_string(w);
+	key += 'x';
+	key += std::to_string(h);
+	return key;
+}
+
+static int image_file_kind(const char* path) {
+	unsigned char head[16] = {};
+	FILE* f = fl_fopen(path, "rb");
+
+	if (f == nullptr)
+		return IMAGE_FILE_UNKNOWN;
+
+	size_t n = fread(head, 1, sizeof(head), f);
+	fclose(f);
+
+	if (n >= 8 && memcmp(head, "\211PNG\r\n\032\n", 8) == 0)
+		return IMAGE_FILE_PNG;
+	if (n >= 3 && head[0] == 0xFF && head[1] == 0xD8 && head[2] == 0xFF)
+		return IMAGE_FILE_JPEG;
+	if (n >= 2 && head[0] == 'B' && head[1] == 'M')
+		return IMAGE_FILE_BMP;
+
+	const char* ext = strrchr(path, '.');
+
+	if ((n >= 5 && memcmp(head, "<?xml", 5) == 0) || (n >= 4 && memcmp(head, "<svg", 4) == 0)
+			|| (ext != nullptr && (strcmp(ext, ".svg") == 0 || strcmp(ext, ".svgz") == 0)))
+		return IMAGE_FILE_SVG;
+
+	return IMAGE_FILE_UNKNOWN;
+}
+
+// Runs on a worker thread.
+static Fl_Image* decode_image(const CachedImage* e) {
+	Fl_Image* img;
+
+	switch (image_file_kind(e->path.c_str())) {
+	case IMAGE_FILE_PNG:
+		img = new Fl_PNG_Image(e->path.c_str());
+		break;
+	case IMAGE_FILE_JPEG:
+		img = new Fl_JPEG_Image(e->path.c_str());
+		break;
+	case IMAGE_FILE_BMP:
+		img = new Fl_BMP_Image(e->path.c_str());
+		break;
+	case IMAGE_FILE_SVG: {
+		Fl_SVG_Image* svg = new Fl_SVG_Image(e->path.c_str());
+
+		if (svg->fail())
+			return svg;
+
+		// Rasterize here rather than on first draw.
+		if (e->w > 0 && e->h > 0)
+			svg->resize(e->w, e->h);
+		else
+			svg->normalize();
+		return svg;
+	}
+	default:
+		return nullptr;
+	}
+
+	return img;
+}
+
+static void image_worker() {
+	std::unique_lock<std::mutex> guard(cache.lock);
+
+	for (;;) {
+		cache.wake.wait(guard, [] { return !cache.jobs.empty(); });
+
+		ImageJob job = cache.jobs.front();
+		cache.jobs.pop_front();
+		guard.unlock();
+
+		Fl_Image* img = job.source != nullptr ? job.source->copy(job.entry->w, job.entry->h) : decode_image(job.entry);
+
+		if (img != nullptr && img->fail()) {
+			delete img;
+			img = nullptr;
+		}
+
+		job.entry->result = img;
+
+		guard.lock();
+		cache.done.push_back(job.entry);
+		guard.unlock();
+
+		awake_post(jobs_done);
+		guard.lock();
+	}
+}
+
+static void image_submit(CachedImage* e, Fl_Image* source) {
+	std::lock_guard<std::mutex> guard(cache.lock);
+
+	if (cache.max_workers <= 0) {
+		unsigned n = std::thread::hardware_concurrency() / 2;
+		cache.max_workers = n > 0 ? (int)n : 1;
+	}
+
+	cache.jobs.push_back(ImageJob{ e, source });
+
+	if (cache.workers < cache.max_workers) {
+		std::thread(image_worker).detach();
+		cache.workers++;
+	}
+
+	cache.wake.notify_one();
+}
+
+static size_t image_bytes(Fl_Image* img) {
+	if (img == nullptr)
+		return 0;
+
+	int d = img->d() > 0 ? img->d() : 4;
+	return (size_t)img->data_w() * img->data_h() * d;
+}
+
+static void image_evict() {
+	for (auto it = cache.lru.end(); cache.bytes > cache.budget && it != cache.lru.begin();) {
+		CachedImage* e = *--it;
+
+		if (e->refs > 0)
+			continue;
+
+		it = cache.lru.erase(it);
+		cache.bytes -= e->bytes;
+		cache.stats.evictions++;
+		delete e->image;
+		cache.entries.erase(image_key(e->path.c_str(), e->w, e->h));
+	}
+}
+
+static void image_touch(CachedImage* e) {
+	if (e->in_lru)
+		cache.lru.splice(cache.lru.begin(), cache.lru, e->lru);
+}
+
+static void image_finish(CachedImage* e, Fl_Image* img);
+
+// Starts producing a sized entry from its (ready) full-size entry.
+static void image_scale_from(CachedImage* e, CachedImage* base) {
+	if (base->state == IMAGE_FAILED) {
+		image_finish(e, nullptr);
+		return;
+	}
+
+	// SVGs are rasterized at the requested size instead of scaling pixels.
+	if (dynamic_cast<Fl_SVG_Image*>(base->image) != nullptr) {
+		image_submit(e, nullptr);
+		return;
+	}
+
+	base->refs++;
+	e->source = base;
+	image_submit(e, base->image);
+}
+
+static void image_finish(CachedImage* e, Fl_Image* img) {
+	e->image = img;
+	e->state = img != nullptr ? IMAGE_READY : IMAGE_FAILED;
+	e->bytes = image_bytes(img);
+	e->lru = cache.lru.insert(cache.lru.begin(), e);
+	e->in_lru = true;
+	cache.bytes += e->bytes;
+	cache.pending--;
+
+	if (img == nullptr)
+		cache.stats.failed++;
+	else if (e->w > 0)
+		cache.stats.scaled++;
+	else
+		cache.stats.decoded++;
+
+	for (Fl_Widget*& w : e->waiters) {
+		if (w != nullptr)
+			w->redraw();
+		Fl::release_widget_pointer(w);
+	}
+
+	e->waiters.clear();
+
+	std::vector<CachedImage*> dependents;
+	dependents.swap(e->dependents);
+
+	for (CachedImage* d : dependents)
+		image_scale_from(d, e);
+
+	if (e->source != nullptr) {
+		e->source->refs--;
+		e->source = nullptr;
+	}
+}
+
+static void image_jobs_done(void*) {
+	std::vector<CachedImage*> done;
+
+	awake_drained(jobs_done);
+
+	{
+		std::lock_guard<std::mutex> guard(cache.lock);
+		done.swap(cache.done);
+	}
+
+	for (CachedImage* e : done)
+		image_finish(e, e->result);
+
+	image_evict();
+}
+
+static CachedImage* image_lookup(const char* path, int w, int h, Fl_Widget* requester) {
+	if (w <= 0 || h <= 0)
+		w = h = 0;
+
+	std::string key = image_key(path, w, h);
+	auto found = cache.entries.find(key);
+	CachedImage* e;
+
+	if (found != cache.entries.end()) {
+		e = found->second.get();
+		cache.stats.hits++;
+		image_touch(e);
+	} else {
+		e = new CachedImage();
+		e->path = path;
+		e->w = w;
+		e->h = h;
+		e->state = IMAGE_PENDING;
+		cache.entries.emplace(std::move(key), std::unique_ptr<CachedImage>(e));
+		cache.pending++;
+		cache.stats.misses++;
+
+		if (w == 0) {
+			image_submit(e, nullptr);
+		} else {
+			CachedImage* base = image_lookup(path, 0, 0, nullptr);
+
+			if (base->state == IMAGE_PENDING)
+				base->dependents.push_back(e);
+			else
+				image_scale_from(e, base);
+		}
+	}
+
+	// Once per widget: it may redraw many times before the decode is done.
+	if (e->state == IMAGE_PENDING && requester != nullptr &&
+			std::find(e->waiters.begin(), e->waiters.end(), requester) == e->waiters.end()) {
+		e->waiters.push_back(requester);
+		Fl::watch_widget_pointer(e->waiters.back());
+	}
+
+	return e;
+}
+
+// Sets the decoded-bytes budget (0 keeps the current one) and the number of
+// decode threads (0 keeps the current one; threads already started stay).
+extern "C" void ImageCache_Configure(size_t budget, int workers) {
+	if (budget > 0)
+		cache.budget = budget;
+
+	if (workers > 0) {
+		std::lock_guard<std::mutex> guard(cache.lock);
+		cache.max_workers = workers;
+	}
+
+	image_evict();
+}
+
+// Shown while an image is being decoded. Owned by the caller.
+extern "C" void ImageCache_SetPlaceholder(Fl_Image* img) {
+	cache.placeholder = img;
+}
+
+// Returns the image for path at w x h (0 x 0 for its own size), or the
+// placeholder if it isn't decoded yet, in which case requester (if not null) is
+// redrawn once it is. Returns null if decoding failed. The image may be evicted
+// by any later cache call; pin it with ImageCache_Acquire() to keep it.
+extern "C" Fl_Image* ImageCache_Get(const char* path, int w, int h, Fl_Widget* requester) {
+	CachedImage* e = image_lookup(path, w, h, requester);
+
+	// Over budget on its own, e must still outlive this call.
+	e->refs++;
+	image_evict();
+	e->refs--;
+
+	if (e->state == IMAGE_PENDING)
+		return cache.placeholder;
+
+	return e->image;
+}
+
+extern "C" void ImageCache_Draw(const char* path, int x, int y, int w, int h, Fl_Widget* requester) {
+	Fl_Image* img = ImageCache_Get(path, w, h, requester);
+
+	if (img != nullptr)
+		img->draw(x, y, w > 0 ? w : img->w(), h > 0 ? h : img->h());
+}
+
+// Pins the entry for path at w x h until ImageCache_Release().
+extern "C" CachedImage* ImageCache_Acquire(const char* path, int w, int h, Fl_Widget* requester) {
+	CachedImage* e = image_lookup(path, w, h, requester);
+
+	e->refs++;
+	return e;
+}
+
+// The pinned entry's image, or the placeholder while it is pending.
+extern "C" Fl_Image* ImageCache_Image(CachedImage* e) {
+	return e->state == IMAGE_PENDING ? cache.placeholder : e->image;
+}
+
+extern "C" int ImageCache_Ready(CachedImage* e) {
+	return e->state != IMAGE_PENDING;
+}
+
+extern "C" void ImageCache_Release(CachedImage* e) {
+	if (e->refs > 0)
+		e->refs--;
+
+	image_evict();
+}
+
+// Drops every unpinned, decoded entry.
+extern "C" void ImageCache_Clear() {
+	size_t budget = cache.budget;
+
+	cache.budget = 0;
+	image_evict();
+	cache.budget = budget;
+}
+
+extern "C" void ImageCache_Stats(ImageCacheStats* stats) {
+	*stats = cache.stats;
+	stats->bytes = (long long)cache.bytes;
+	stats->budget = (long long)cache.budget;
+	stats->entries = (int)cache.entries.size();
+	stats->pending = cache.pending;
+}
@@ -0,0 +1,522 @@
+#include "fltk_d_wrapper.h"
+#include <vector>
+#include <unordered_map>
+#include <errno.h>
+#include <string.h>
+
+// I/O reactor: any number of descriptors behind one epoll fd, which is the
+// only descriptor handed to Fl::add_fd().
+//
+// Fl::add_fd() keeps one callback per descriptor and rebuilds select() sets on
+// every loop iteration. Here the FLTK loop only watches the epoll fd; when it
+// is readable, one epoll_wait() collects every ready descriptor and D gets
+// them all in a single dispatch call.
+//
+// Watches with IO_RECV are drained by the reactor into their own receive
+// buffer, and the event carries a pointer to the unconsumed bytes: D parses
+// them in place and calls IoReactor_Consume() for what it used. A full buffer
+// stops reading that descriptor until D consumes (back pressure). Writes that
+// can't complete at once are queued and flushed on EPOLLOUT. A peer that went
+// away shows up as IO_ERROR (EPIPE), never as SIGPIPE.
+//
+// Linux only; elsewhere IoReactor_Create() returns null. Main thread only.
+// Descriptors are switched to non-blocking mode and must be removed before
+// they are closed. After IO_HUP or IO_ERROR a watch gets no more events.
+
+#define IO_READ 1     // readable (D reads itself)
+#define IO_WRITE 2    // the write queue drained
+#define IO_RECV 4     // the reactor reads into the receive buffer
+#define IO_HUP 8      // end of file / peer closed
+#define IO_ERROR 16   // error, see IoEvent.error
+
+#define IO_DEFAULT_RECV_BUFFER 65536
+
+// Must match struct IoEvent in source/fltk_d_io.d
+struct IoEvent {
+	int fd;
+	int events;
+	void* data;
+	const char* recv;  // unconsumed received bytes (IO_RECV watches)
+	size_t recv_len;
+	int error;         // errno for IO_ERROR
+};
+
+struct IoReactorStats {
+	long long wakeups;
+	long long events;
+	long long batches;
+	long long bytes_in;
+	long long bytes_out;
+	int watches;
+};
+
+typedef void (*IoDispatchProc)(void* data, const IoEvent* events, size_t count);
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+struct IoWatch {
+	int fd;
+	int flags;
+	void* data;
+	bool socket;
+	unsigned interest;  // epoll events currently registered
+	bool dead;          // reported IO_HUP or IO_ERROR, no longer in the epoll set
+	bool parked;        // hung up with a full buffer, out of the epoll set until D consumes
+
+	std::vector<char> in;
+	size_t in_start, in_end;
+	bool eof;
+
+	std::vector<char> out;
+	size_t out_start;
+};
+
+struct IoReactor {
+	int epfd;
+	std::vector<epoll_event> ready;
+	std::unordered_map<int, IoWatch*> watches;
+	std::vector<IoWatch*> removed;  // freed after the dispatch that may still see them
+	bool dispatching;
+	bool destroyed;  // by the dispatch; freed once it returns
+
+	std::vector<IoEvent> batch;
+	IoDispatchProc dispatch;
+	void* data;
+
+	IoReactorStats stats;
+};
+
+static void io_reactor_cb(FL_SOCKET fd, void* data);
+
+static void io_interest(IoReactor* r, IoWatch* w) {
+	unsigned interest = 0;
+
+	if (w->dead)
+		return;
+
+	// io_receive() moves partly consumed bytes to the front to make room.
+	if ((w->flags & IO_READ) || ((w->flags & IO_RECV) && !w->eof && w->in_end - w->in_start < w->in.size()))
+		interest |= EPOLLIN;
+	if (w->out_start < w->out.size())
+		interest |= EPOLLOUT;
+
+	if (interest == w->interest && !w->parked)
+		return;
+
+	// epoll reports a hangup whatever the interest is: a parked watch only
+	// goes back into the set once it can do something about it.
+	if (w->parked && interest == 0)
+		return;
+
+	epoll_event ev;
+	ev.events = interest;
+	ev.data.ptr = w;
+	epoll_ctl(r->epfd, w->parked ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, w->fd, &ev);
+	w->interest = interest;
+	w->parked = false;
+}
+
+// Sockets are written with MSG_NOSIGNAL; anything else (pipes) with SIGPIPE
+// blocked, discarding the one the write raised.
+static ssize_t io_write(IoWatch* w, const char* bytes, size_t len) {
+	if (w->socket)
+		return send(w->fd, bytes, len, MSG_NOSIGNAL);
+
+	sigset_t pipe, old;
+
+	sigemptyset(&pipe);
+	sigaddset(&pipe, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &pipe, &old);
+
+	ssize_t n = write(w->fd, bytes, len);
+
+	if (n < 0 && errno == EPIPE && !sigismember(&old, SIGPIPE)) {
+		const timespec zero = { 0, 0 };
+
+		while (sigtimedwait(&pipe, nullptr, &zero) < 0 && errno == EINTR) {
+		}
+
+		errno = EPIPE;
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old, nullptr);
+	return n;
+}
+
+// Reads until EAGAIN or the buffer is full. Returns the events to report.
+static int io_receive(IoReactor* r, IoWatch* w, int* error) {
+	// Room at the end: move the unconsumed bytes to the front.
+	if (w->in_end == w->in.size() && w->in_start > 0) {
+		memmove(w->in.data(), w->in.data() + w->in_start, w->in_end - w->in_start);
+		w->in_end -= w->in_start;
+		w->in_start = 0;
+	}
+
+	int events = 0;
+
+	while (w->in_end < w->in.size()) {
+		ssize_t n = read(w->fd, w->in.data() + w->in_end, w->in.size() - w->in_end);
+
+		if (n > 0) {
+			w->in_end += n;
+			r->stats.bytes_in += n;
+			events |= IO_RECV;
+		} else if (n == 0) {
+			w->eof = true;
+			events |= IO_HUP;
+			break;
+		} else {
+			if (errno == EINTR)
+				continue;
+
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				*error = errno;
+				events |= IO_ERROR;
+			}
+			break;
+		}
+	}
+
+	return events;
+}
+
+// Writes queued bytes until EAGAIN. Returns the events to report.
+static int io_flush(IoReactor* r, IoWatch* w, int* error) {
+	while (w->out_start < w->out.size()) {
+		ssize_t n = io_write(w, w->out.data() + w->out_start, w->out.size() - w->out_start);
+
+		if (n > 0) {
+			w->out_start += n;
+			r->stats.bytes_out += n;
+		} else if (n < 0 && errno == EINTR) {
+			continue;
+		} else {
+			if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+				*error = errno;
+				return IO_ERROR;
+			}
+			return 0;
+		}
+	}
+
+	w->out.clear();
+	w->out_start = 0;
+	return IO_WRITE;
+}
+
+static void io_reactor_cb(FL_SOCKET, void* data) {
+	IoReactor* r = (IoReactor*)data;
+	int n = epoll_wait(r->epfd, r->ready.data(), (int)r->ready.size(), 0);
+
+	r->stats.wakeups++;
+	r->batch.clear();
+
+	for (int k = 0; k < n; k++) {
+		IoWatch* w = (IoWatch*)r->ready[k].data.ptr;
+		unsigned ready = r->ready[k].events;
+		IoEvent ev = { w->fd, 0, w->data, nullptr, 0, 0 };
+
+		if (ready & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+			if (w->flags & IO_RECV)
+				ev.events |= io_receive(r, w, &ev.error);
+			else if (w->flags & IO_READ)
+				ev.events |= IO_READ;
+		}
+
+		if (ready & EPOLLOUT) {
+			int events = io_flush(r, w, &ev.error);
+
+			// Drained is only news to watches that asked for it.
+			ev.events |= events == IO_WRITE && !(w->flags & IO_WRITE) ? 0 : events;
+		}
+
+		if ((ready & EPOLLHUP) && !(w->flags & IO_RECV))
+			ev.events |= IO_HUP;
+
+		// Hung up, but a full buffer keeps io_receive() from reading on to the
+		// end of file: until D consumes, the hangup would wake the loop again
+		// and again.
+		if ((ready & EPOLLHUP) && (w->flags & IO_RECV) && !(ev.events & (IO_HUP | IO_ERROR)) &&
+				w->in_end - w->in_start == w->in.size() && !w->dead && !w->parked) {
+			epoll_ctl(r->epfd, EPOLL_CTL_DEL, w->fd, nullptr);
+			w->parked = true;
+			w->interest = 0;
+		}
+		if ((ready & EPOLLERR) && !(ev.events & IO_ERROR)) {
+			socklen_t len = sizeof(ev.error);
+
+			// Not a socket (a pipe): nothing more specific to say.
+			if (getsockopt(w->fd, SOL_SOCKET, SO_ERROR, &ev.error, &len) < 0 || ev.error == 0)
+				ev.error = EIO;
+
+			ev.events |= IO_ERROR;
+		}
+
+		// epoll keeps reporting hangups and errors whatever the interest is.
+		if ((ev.events & (IO_HUP | IO_ERROR)) && !w->dead) {
+			if (!w->parked)
+				epoll_ctl(r->epfd, EPOLL_CTL_DEL, w->fd, nullptr);
+
+			w->dead = true;
+		}
+
+		io_interest(r, w);
+
+		if (ev.events == 0)
+			continue;
+
+		if (w->flags & IO_RECV) {
+			ev.recv = w->in.data() + w->in_start;
+			ev.recv_len = w->in_end - w->in_start;
+		}
+
+		r->batch.push_back(ev);
+	}
+
+	if (!r->batch.empty()) {
+		r->stats.events += r->batch.size();
+		r->stats.batches++;
+
+		r->dispatching = true;
+		r->dispatch(r->data, r->batch.data(), r->batch.size());
+		r->dispatching = false;
+	}
+
+	for (IoWatch* w : r->removed)
+		delete w;
+
+	r->removed.clear();
+
+	if (r->destroyed)
+		delete r;
+}
+
+static IoWatch* io_find(IoReactor* r, int fd) {
+	auto it = r->watches.find(fd);
+	return it != r->watches.end() ? it->second : nullptr;
+}
+
+// max_events is how many ready descriptors one wake-up collects at most.
+extern "C" IoReactor* IoReactor_Create(int max_events, IoDispatchProc dispatch, void* data) {
+	int epfd = epoll_create1(EPOLL_CLOEXEC);
+
+	if (epfd < 0)
+		return nullptr;
+
+	IoReactor* r = new IoReactor();
+
+	r->epfd = epfd;
+	r->ready.resize(max_events > 0 ? max_events : 256);
+	r->dispatching = false;
+	r->destroyed = false;
+	r->dispatch = dispatch;
+	r->data = data;
+	r->stats = {};
+
+	Fl::add_fd(epfd, FL_READ, io_reactor_cb, r);
+	return r;
+}
+
+// Also from inside the dispatch; the rest of that batch is still delivered,
+// but r must not be used again.
+extern "C" void IoReactor_Destroy(IoReactor* r) {
+	Fl::remove_fd(r->epfd);
+	close(r->epfd);
+
+	for (auto& kv : r->watches)
+		r->removed.push_back(kv.second);
+
+	r->watches.clear();
+
+	if (r->dispatching) {
+		r->destroyed = true;
+		return;
+	}
+
+	for (IoWatch* w : r->removed)
+		delete w;
+
+	delete r;
+}
+
+// flags: IO_READ and/or IO_RECV, plus IO_WRITE to hear when queued writes
+// drained. recv_buffer is the receive buffer size for IO_RECV (0: default).
+// Returns 0, or -1 with errno set.
+extern "C" int IoReactor_Add(IoReactor* r, int fd, int flags, size_t recv_buffer, void* data) {
+	if (io_find(r, fd) != nullptr) {
+		errno = EEXIST;
+		return -1;
+	}
+
+	int fl = fcntl(fd, F_GETFL);
+
+	if (fl < 0 || fcntl(fd, F_SETFL, fl | O_NONBLOCK) < 0)
+		return -1;
+
+	IoWatch* w = new IoWatch();
+	int type;
+	socklen_t type_len = sizeof(type);
+
+	w->fd = fd;
+	w->flags = flags;
+	w->data = data;
+	w->socket = getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &type_len) == 0;
+	w->dead = false;
+	w->parked = false;
+	w->in.resize(flags & IO_RECV ? (recv_buffer > 0 ? recv_buffer : IO_DEFAULT_RECV_BUFFER) : 0);
+	w->in_start = w->in_end = 0;
+	w->eof = false;
+	w->out_start = 0;
+
+	epoll_event ev;
+	ev.events = flags & (IO_READ | IO_RECV) ? EPOLLIN : 0;
+	ev.data.ptr = w;
+
+	if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		delete w;
+		return -1;
+	}
+
+	w->interest = ev.events;
+	r->watches[fd] = w;
+	r->stats.watches++;
+	return 0;
+}
+
+// Stops watching fd (queued writes are dropped); the caller closes it.
+extern "C" int IoReactor_Remove(IoReactor* r, int fd) {
+	IoWatch* w = io_find(r, fd);
+
+	if (w == nullptr)
+		return 0;
+
+	if (!w->dead && !w->parked)
+		epoll_ctl(r->epfd, EPOLL_CTL_DEL, fd, nullptr);
+
+	r->watches.erase(fd);
+	r->stats.watches--;
+
+	// The batch being dispatched may point into its receive buffer.
+	if (r->dispatching) {
+		r->removed.push_back(w);
+	} else {
+		delete w;
+	}
+
+	return 1;
+}
+
+// Releases n received bytes of an IO_RECV watch; the rest stays readable at
+// the same address until the reactor next reads.
+extern "C" void IoReactor_Consume(IoReactor* r, int fd, size_t n) {
+	IoWatch* w = io_find(r, fd);
+
+	if (w == nullptr)
+		return;
+
+	if (n > w->in_end - w->in_start)
+		n = w->in_end - w->in_start;
+
+	w->in_start += n;
+
+	if (w->in_start == w->in_end)
+		w->in_start = w->in_end = 0;
+
+	io_interest(r, w);
+}
+
+// Unconsumed received bytes of an IO_RECV watch.
+extern "C" const char* IoReactor_Received(IoReactor* r, int fd, size_t* len) {
+	IoWatch* w = io_find(r, fd);
+
+	if (w == nullptr) {
+		*len = 0;
+		return nullptr;
+	}
+
+	*len = w->in_end - w->in_start;
+	return w->in.data() + w->in_start;
+}
+
+// Writes what the descriptor takes now and queues the rest. Returns the bytes
+// queued behind, or -1 with errno set.
+extern "C" long long IoReactor_Write(IoReactor* r, int fd, const char* bytes, size_t len) {
+	IoWatch* w = io_find(r, fd);
+
+	if (w == nullptr) {
+		errno = EBADF;
+		return -1;
+	}
+
+	if (w->out_start == w->out.size()) {
+		while (len > 0) {
+			ssize_t n = io_write(w, bytes, len);
+
+			if (n > 0) {
+				bytes += n;
+				len -= n;
+				r->stats.bytes_out += n;
+			} else if (n < 0 && errno == EINTR) {
+				continue;
+			} else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+				return -1;
+			} else {
+				break;
+			}
+		}
+	}
+
+	w->out.insert(w->out.end(), bytes, bytes + len);
+	io_interest(r, w);
+	return (long long)(w->out.size() - w->out_start);
+}
+
+extern "C" void IoReactor_Stats(IoReactor* r, IoReactorStats* stats) {
+	*stats = r->stats;
+}
+
+#else
+
+struct IoReactor;
+
+extern "C" IoReactor* IoReactor_Create(int, IoDispatchProc, void*) {
+	return nullptr;
+}
+
+extern "C" void IoReactor_Destroy(IoReactor*) {
+}
+
+extern "C" int IoReactor_Add(IoReactor*, int, int, size_t, void*) {
+	errno = ENOSYS;
+	return -1;
+}
+
+extern "C" int IoReactor_Remove(IoReactor*, int) {
+	return 0;
+}
+
+extern "C" void IoReactor_Consume(IoReactor*, int, size_t) {
+}
+
+extern "C" const char* IoReactor_Received(IoReactor*, int, size_t* len) {
+	*len = 0;
+	return nullptr;
+}
+
+extern "C" long long IoReactor_Write(IoReactor*, int, const char*, size_t) {
+	errno = ENOSYS;
+	return -1;
+}
+
+extern "C" void IoReactor_Stats(IoReactor*, IoReactorStats* stats) {
+	*stats = {};
+}
+
+#endif
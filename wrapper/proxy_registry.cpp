@@ -0,0 +1,68 @@
+#include "fltk_d_wrapper.h"
+
+// Liveness of the widgets in the D proxy cache (source/fltk_d_proxy.d).
+//
+// A widget with a cached proxy carries PROXY_TRACKED, one of the flags FLTK
+// reserves for extensions. Fl_Widget's constructor starts with the flag clear,
+// so looking up a live pointer tells the cached widget from a new one that got
+// its address, in O(1) and without FLTK's widget watch list (a flat array
+// scanned by every ~Fl_Widget).
+//
+// Widgets deleted through the release path (see callback_registry.cpp), which
+// includes the delete of an owning proxy, also tell D to drop their entries,
+// and whatever D pinned to them.
+
+// The flags are protected; a pointer to member formed through a derived class
+// can still be applied to any widget.
+struct WidgetFlags : public Fl_Widget {
+	static const unsigned TRACKED = USERFLAG3;
+
+	static unsigned get(Fl_Widget* w) { return (w->*&WidgetFlags::flags)(); }
+	static void set(Fl_Widget* w, unsigned f) { (w->*&WidgetFlags::set_flag)(f); }
+	static void clear(Fl_Widget* w, unsigned f) { (w->*&WidgetFlags::clear_flag)(f); }
+};
+
+#define PROXY_TRACKED WidgetFlags::TRACKED
+
+static ProxyReleaseProc release_hook = nullptr;
+static int proxy_live = 0;
+
+extern "C" void ProxyRegistry_SetReleaseHook(ProxyReleaseProc hook) {
+	release_hook = hook;
+}
+
+extern "C" void ProxyRegistry_Track(Fl_Widget* w) {
+	if (WidgetFlags::get(w) & PROXY_TRACKED)
+		return;
+
+	WidgetFlags::set(w, PROXY_TRACKED);
+	proxy_live++;
+}
+
+// w must be alive.
+extern "C" int ProxyRegistry_Tracked(Fl_Widget* w) {
+	return (WidgetFlags::get(w) & PROXY_TRACKED) != 0;
+}
+
+extern "C" void ProxyRegistry_Untrack(Fl_Widget* w) {
+	if (!(WidgetFlags::get(w) & PROXY_TRACKED))
+		return;
+
+	WidgetFlags::clear(w, PROXY_TRACKED);
+	proxy_live--;
+}
+
+// From the destruction path: w is still alive, but not for long.
+extern "C" void ProxyRegistry_Release(Fl_Widget* w) {
+	if (!(WidgetFlags::get(w) & PROXY_TRACKED))
+		return;
+
+	ProxyRegistry_Untrack(w);
+
+	if (release_hook != nullptr)
+		release_hook(w);
+}
+
+extern "C" void ProxyRegistry_Stats(int* live) {
+	*live = proxy_live;
+}
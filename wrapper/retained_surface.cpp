@@ -0,0 +1,58 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/Fl_Image_Surface.H>
+#include <Fl/fl_draw.H>
+
+// Retained (offscreen) drawing for the custom widgets (see template.cpp).
+//
+// A retained widget is rasterized into an Fl_Image_Surface, and every draw()
+// after that is a single fl_copy_offscreen() of it. The widget's own draw hooks
+// only run again once it has been invalidated (RetainedSurface_Invalidate(),
+// e.g. because its data changed) or resized. Expose events, overlapping
+// windows and parent redraws all just blit.
+//
+// Meant for leaf widgets that are expensive to paint (charts, waveforms);
+// children of a retained group would be frozen into its image as well.
+
+// Draws w through its retained surface, re-rendering it first if needed.
+// *rendering is set around the nested w->draw() call so that the widget's
+// draw() runs its real drawing code instead of coming back here.
+extern "C" void RetainedSurface_Draw(RetainedSurface* r, Fl_Widget* w, bool* rendering) {
+	if (w->w() <= 0 || w->h() <= 0)
+		return;
+
+	if (r->surface != nullptr && (r->w != w->w() || r->h != w->h())) {
+		delete r->surface;
+		r->surface = nullptr;
+	}
+
+	if (r->surface == nullptr) {
+		r->surface = new Fl_Image_Surface(w->w(), w->h(), 1);
+		r->w = w->w();
+		r->h = w->h();
+		r->valid = false;
+	}
+
+	if (!r->valid) {
+		Fl_Surface_Device::push_current(r->surface);
+		*rendering = true;
+		r->surface->draw(w, 0, 0);
+		*rendering = false;
+		Fl_Surface_Device::pop_current();
+
+		r->valid = true;
+		r->renders++;
+	}
+
+	fl_copy_offscreen(w->x(), w->y(), w->w(), w->h(), r->surface->offscreen(), 0, 0);
+	r->blits++;
+}
+
+extern "C" void RetainedSurface_Invalidate(RetainedSurface* r) {
+	r->valid = false;
+}
+
+extern "C" void RetainedSurface_Free(RetainedSurface* r) {
+	delete r->surface;
+	r->surface = nullptr;
+	r->valid = false;
+}
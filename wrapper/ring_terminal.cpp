@@ -0,0 +1,228 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/Fl_Simple_Terminal.H>
+#include <Fl/Fl_Text_Buffer.H>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+// Fl_Simple_Terminal tuned for high-rate log tails.
+//
+// append() only copies into a bounded ring of pending bytes; the ring is moved
+// into the text buffer at most once per frame, with a single modify
+// notification and therefore a single relayout/redraw. If producers outrun the
+// frame rate by more than the ring holds, the oldest pending lines are dropped
+// and counted.
+//
+// History is trimmed in batches: the buffer may grow a quarter past
+// history_lines before the excess is removed in one go, so eviction costs one
+// memmove per batch rather than one per appended line.
+//
+// ANSI styling is not supported in this mode; text bypasses
+// Fl_Simple_Terminal::append() and its style buffer entirely.
+
+#define RING_TERMINAL_DEFAULT_RING (4 * 1024 * 1024)
+#define RING_TERMINAL_MIN_SLACK 64
+
+struct RingTerminalStats {
+	double lines_per_second;
+	long long lines_appended;
+	long long lines_dropped;
+	long long lines_evicted;
+	long long flushes;
+	long long redraws_coalesced;
+};
+
+class Ring_Terminal : public Fl_Simple_Terminal {
+public:
+	Ring_Terminal(int x, int y, int w, int h, const char* label = 0);
+	~Ring_Terminal();
+
+	void append(const char* s, int len);
+	void flush();
+
+	void ring_size(int bytes);
+	void history(int lines) { _history = lines; }
+	void frame_interval(double seconds) { _frame_interval = seconds; }
+
+	RingTerminalStats stats;
+
+private:
+	static void flush_cb(void* data);
+
+	void drop_oldest_line();
+
+	// Pending bytes: [_head, _head + _used) modulo _capacity
+	char* _ring = nullptr;
+	int _capacity = 0;
+	int _head = 0;
+	int _used = 0;
+	int _pending_lines = 0;
+
+	int _history = 10000;
+	int _buffer_lines = 0;
+	double _frame_interval = 1.0 / 60;
+	bool _flush_scheduled = false;
+
+	long long _rate_lines = 0;
+	std::chrono::steady_clock::time_point _rate_start;
+};
+
+Ring_Terminal::Ring_Terminal(int x, int y, int w, int h, const char* label): Fl_Simple_Terminal(x, y, w, h, label) {
+	memset(&stats, 0, sizeof(stats));
+	_rate_start = std::chrono::steady_clock::now();
+
+	// We trim ourselves; the base class would do it line by line.
+	Fl_Simple_Terminal::history_lines(-1);
+	ansi(false);
+	buf->canUndo(0);
+	ring_size(RING_TERMINAL_DEFAULT_RING);
+}
+
+Ring_Terminal::~Ring_Terminal() {
+	Fl::remove_timeout(flush_cb, this);
+	free(_ring);
+}
+
+void Ring_Terminal::ring_size(int bytes) {
+	// The ring offsets are taken modulo the capacity.
+	if (bytes < 1)
+		bytes = 1;
+
+	flush();
+	free(_ring);
+	_ring = (char*)malloc(bytes);
+	_capacity = bytes;
+	_head = 0;
+	_used = 0;
+	_pending_lines = 0;
+}
+
+void Ring_Terminal::drop_oldest_line() {
+	int first = _capacity - _head < _used ? _capacity - _head : _used;
+	const char* nl = (const char*)memchr(_ring + _head, '\n', first);
+	int n;
+
+	if (nl != nullptr) {
+		n = (int)(nl - (_ring + _head)) + 1;
+	} else {
+		nl = (const char*)memchr(_ring, '\n', _used - first);
+		n = nl != nullptr ? first + (int)(nl - _ring) + 1 : _used;
+	}
+
+	_head = (_head + n) % _capacity;
+	_used -= n;
+
+	if (nl != nullptr)
+		_pending_lines--;
+
+	stats.lines_dropped++;
+}
+
+void Ring_Terminal::append(const char* s, int len) {
+	if (len < 0)
+		len = (int)strlen(s);
+
+	// Only the tail of an append larger than the whole ring can survive.
+	if (len > _capacity) {
+		stats.lines_dropped += _pending_lines;
+		_head = _used = _pending_lines = 0;
+		s += len - _capacity;
+		len = _capacity;
+	}
+
+	while (_capacity - _used < len)
+		drop_oldest_line();
+
+	int lines = 0;
+	for (const char* p = s; (p = (const char*)memchr(p, '\n', s + len - p)) != nullptr; p++)
+		lines++;
+
+	int tail = (_head + _used) % _capacity;
+	int first = _capacity - tail < len ? _capacity - tail : len;
+
+	memcpy(_ring + tail, s, first);
+	memcpy(_ring, s + first, len - first);
+	_used += len;
+	_pending_lines += lines;
+
+	stats.lines_appended += lines;
+	_rate_lines += lines;
+
+	if (_flush_scheduled) {
+		stats.redraws_coalesced++;
+	} else {
+		_flush_scheduled = true;
+		Fl::add_timeout(_frame_interval, flush_cb, this);
+	}
+}
+
+void Ring_Terminal::flush_cb(void* data) {
+	Ring_Terminal* t = (Ring_Terminal*)data;
+
+	t->_flush_scheduled = false;
+	t->flush();
+}
+
+void Ring_Terminal::flush() {
+	if (_used > 0) {
+		int first = _capacity - _head < _used ? _capacity - _head : _used;
+		DSlice slices[2] = {
+			{ (size_t)first, _ring + _head },
+			{ (size_t)(_used - first), _ring },
+		};
+
+		TextBuffer_AppendSlices(buf, slices, 2);
+		_buffer_lines += _pending_lines;
+		_head = _used = _pending_lines = 0;
+		stats.flushes++;
+	}
+
+	int slack = _history / 4 > RING_TERMINAL_MIN_SLACK ? _history / 4 : RING_TERMINAL_MIN_SLACK;
+
+	if (_history >= 0 && _buffer_lines > _history + slack) {
+		int excess = _buffer_lines - _history;
+
+		buf->remove(0, buf->skip_lines(0, excess));
+		_buffer_lines -= excess;
+		stats.lines_evicted += excess;
+	}
+
+	enforce_stay_at_bottom();
+
+	auto now = std::chrono::steady_clock::now();
+	double elapsed = std::chrono::duration<double>(now - _rate_start).count();
+
+	if (elapsed >= 1.0) {
+		stats.lines_per_second = _rate_lines / elapsed;
+		_rate_lines = 0;
+		_rate_start = now;
+	}
+}
+
+extern "C" Ring_Terminal* RingTerminal_Create(int x, int y, int w, int h, const char* label = 0) {
+	return new Ring_Terminal(x, y, w, h, label);
+}
+
+extern "C" void RingTerminal_Append(Ring_Terminal* t, const char* s, int len) {
+	t->append(s, len);
+}
+
+extern "C" void RingTerminal_Flush(Ring_Terminal* t) {
+	t->flush();
+}
+
+extern "C" void RingTerminal_SetHistory(Ring_Terminal* t, int lines) {
+	t->history(lines);
+}
+
+extern "C" void RingTerminal_SetRingSize(Ring_Terminal* t, int bytes) {
+	t->ring_size(bytes);
+}
+
+extern "C" void RingTerminal_SetFrameInterval(Ring_Terminal* t, double seconds) {
+	t->frame_interval(seconds);
+}
+
+extern "C" void RingTerminal_Stats(Ring_Terminal* t, RingTerminalStats* stats) {
+	*stats = t->stats;
+}
@@ -0,0 +1,424 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/Fl_Widget.H>
+#include <Fl/fl_draw.H>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// Line chart for very long sample series, drawn from a D-owned buffer.
+//
+// Fl_Chart copies every value into its own entry array and draws all of them.
+// Series_Chart only keeps a pointer to the caller's samples plus a min/max
+// pyramid: level 0 summarizes SC_BASE_BUCKET samples per bucket, every level
+// above halves the bucket count. A redraw picks the coarsest level whose buckets
+// are still narrower than a pixel and reduces it to one min/max pair per
+// column, so its cost depends on the widget width, not on the series length,
+// for any zoom. Column edges are rounded to bucket boundaries of that level.
+// Below SC_BASE_BUCKET samples per pixel columns are reduced from the raw
+// samples, and below two the samples are drawn as a polyline.
+//
+// append() only rebuilds the pyramid buckets touched by the new samples.
+// Zooming and panning (also with the mouse wheel and dragging) only change
+// which range is reduced; the raw series is never rescanned.
+//
+// NaN samples are skipped.
+
+#define SC_BASE_BUCKET 16
+
+enum SeriesType {
+	SERIES_FLOAT,
+	SERIES_DOUBLE,
+};
+
+struct SeriesChartStats {
+	long long redraws;
+	long long buckets_read;  // pyramid buckets read by the last redraw
+	long long samples_read;  // raw samples read by the last redraw
+	int levels;
+};
+
+struct MinMaxLevel {
+	int bucket;  // samples per bucket
+	std::vector<float> min;
+	std::vector<float> max;
+};
+
+class Series_Chart : public Fl_Widget {
+public:
+	Series_Chart(int x, int y, int w, int h, const char* label = 0);
+
+	void data(const void* samples, int type, long long count);
+	void append(const void* samples, long long count);
+	void view(long long first, long long count);
+	void bounds(double lo, double hi);
+
+	int handle(int evt) override;
+
+	SeriesChartStats stats;
+
+protected:
+	void draw() override;
+
+private:
+	double sample(long long i) const {
+		return _type == SERIES_FLOAT ? ((const float*)_data)[i] : ((const double*)_data)[i];
+	}
+
+	void rebuild(long long from);
+	void visible(long long* first, long long* count) const;
+
+	const void* _data = nullptr;
+	int _type = SERIES_FLOAT;
+	long long _count = 0;
+
+	std::vector<MinMaxLevel> _levels;
+
+	long long _view_first = -1;  // -1: follow the end of the series
+	long long _view_count = 0;   // 0: the whole series
+	double _lo = 0, _hi = 0;     // lo == hi: fit the visible data
+
+	int _drag_x = 0;
+	long long _drag_first = 0;
+};
+
+Series_Chart::Series_Chart(int x, int y, int w, int h, const char* label): Fl_Widget(x, y, w, h, label) {
+	box(FL_DOWN_BOX);
+	color(FL_BACKGROUND2_COLOR);
+	selection_color(FL_FOREGROUND_COLOR);
+	memset(&stats, 0, sizeof(stats));
+}
+
+// Points the chart at count samples of type (SeriesType). The buffer stays owned
+// by the caller; call data() again if it moves.
+void Series_Chart::data(const void* samples, int type, long long count) {
+	bool same = samples == _data && type == _type && count >= _count;
+	long long from = same ? _count : 0;
+
+	_data = samples;
+	_type = type;
+	_count = count;
+	rebuild(from);
+	redraw();
+}
+
+// The caller has written count more samples after the current ones; samples
+// is the (possibly moved) start of the buffer, or null if it didn't move.
+void Series_Chart::append(const void* samples, long long count) {
+	long long from = _count;
+	long long first, n;
+
+	if (samples != nullptr)
+		_data = samples;
+
+	visible(&first, &n);
+	_count += count;
+	rebuild(from);
+
+	// Only redraw if the new samples can show up.
+	if (_view_first < 0 || _view_count == 0 || first + n > from)
+		redraw();
+}
+
+void Series_Chart::rebuild(long long from) {
+	long long buckets = (_count + SC_BASE_BUCKET - 1) / SC_BASE_BUCKET;
+	int depth = 0;
+
+	for (long long b = buckets; b > 1; b = (b + 1) / 2)
+		depth++;
+
+	_levels.resize(depth + 1);
+	stats.levels = depth + 1;
+
+	for (int l = 0; l <= depth; l++) {
+		MinMaxLevel& level = _levels[l];
+		long long first_bucket;
+
+		level.bucket = SC_BASE_BUCKET << l;
+		level.min.resize(buckets);
+		level.max.resize(buckets);
+		first_bucket = from / level.bucket;
+
+		for (long long b = first_bucket; b < buckets; b++) {
+			float mn = INFINITY, mx = -INFINITY;
+
+			if (l == 0) {
+				long long end = (b + 1) * SC_BASE_BUCKET < _count ? (b + 1) * SC_BASE_BUCKET : _count;
+
+				for (long long i = b * SC_BASE_BUCKET; i < end; i++) {
+					float v = (float)sample(i);
+
+					if (v < mn)
+						mn = v;
+					if (v > mx)
+						mx = v;
+				}
+			} else {
+				const MinMaxLevel& below = _levels[l - 1];
+
+				for (long long c = 2 * b; c < 2 * b + 2 && c < (long long)below.min.size(); c++) {
+					if (below.min[c] < mn)
+						mn = below.min[c];
+					if (below.max[c] > mx)
+						mx = below.max[c];
+				}
+			}
+
+			level.min[b] = mn;
+			level.max[b] = mx;
+		}
+
+		buckets = (buckets + 1) / 2;
+	}
+}
+
+// Shows count samples starting at first; first = -1 follows the end of the
+// series, count = 0 shows all of it.
+void Series_Chart::view(long long first, long long count) {
+	_view_first = first;
+	_view_count = count > 0 ? count : 0;
+	redraw();
+}
+
+// Fixed value range; lo == hi fits the visible samples.
+void Series_Chart::bounds(double lo, double hi) {
+	_lo = lo;
+	_hi = hi;
+	redraw();
+}
+
+void Series_Chart::visible(long long* first, long long* count) const {
+	long long n = _view_count > 0 && _view_count < _count ? _view_count : _count;
+	long long f = _view_first < 0 ? _count - n : _view_first;
+
+	if (f + n > _count)
+		f = _count - n;
+	if (f < 0)
+		f = 0;
+
+	*first = f;
+	*count = n;
+}
+
+void Series_Chart::draw() {
+	int X = x() + Fl::box_dx(box()), Y = y() + Fl::box_dy(box());
+	int W = w() - Fl::box_dw(box()), H = h() - Fl::box_dh(box());
+	long long first, count;
+
+	draw_box();
+	draw_label();
+	stats.redraws++;
+	stats.buckets_read = 0;
+	stats.samples_read = 0;
+
+	visible(&first, &count);
+
+	if (W <= 0 || H <= 0 || count <= 0 || _data == nullptr)
+		return;
+
+	double per_pixel = (double)count / W;
+	int columns = per_pixel >= 2.0 ? W : (int)count;
+	std::vector<float> cmin(columns), cmax(columns);
+
+	if (per_pixel >= 2.0 && per_pixel < SC_BASE_BUCKET) {
+		// Fewer samples per column than a level 0 bucket: reduce them directly.
+		for (int c = 0; c < columns; c++) {
+			long long i0 = first + (long long)(c * per_pixel);
+			long long i1 = first + (long long)((c + 1) * per_pixel);
+			float mn = INFINITY, mx = -INFINITY;
+
+			if (i1 > _count)
+				i1 = _count;
+
+			for (long long i = i0; i < i1; i++) {
+				float v = (float)sample(i);
+
+				if (v < mn)
+					mn = v;
+				if (v > mx)
+					mx = v;
+			}
+
+			stats.samples_read += i1 - i0;
+			cmin[c] = mn;
+			cmax[c] = mx;
+		}
+	} else if (per_pixel >= 2.0) {
+		// Coarsest level whose buckets are at most one pixel wide.
+		int l = 0;
+
+		while (l + 1 < (int)_levels.size() && _levels[l + 1].bucket <= per_pixel)
+			l++;
+
+		const MinMaxLevel& level = _levels[l];
+
+		for (int c = 0; c < columns; c++) {
+			long long b0 = (first + (long long)(c * per_pixel)) / level.bucket;
+			long long b1 = (first + (long long)((c + 1) * per_pixel) + level.bucket - 1) / level.bucket;
+			float mn = INFINITY, mx = -INFINITY;
+
+			if (b1 > (long long)level.min.size())
+				b1 = level.min.size();
+
+			for (long long b = b0; b < b1; b++) {
+				if (level.min[b] < mn)
+					mn = level.min[b];
+				if (level.max[b] > mx)
+					mx = level.max[b];
+			}
+
+			stats.buckets_read += b1 - b0;
+			cmin[c] = mn;
+			cmax[c] = mx;
+		}
+	} else {
+		for (int c = 0; c < columns; c++)
+			cmin[c] = cmax[c] = (float)sample(first + c);
+
+		stats.samples_read = columns;
+	}
+
+	double lo = _lo, hi = _hi;
+
+	if (lo == hi) {
+		lo = INFINITY;
+		hi = -INFINITY;
+
+		for (int c = 0; c < columns; c++) {
+			if (cmin[c] < lo)
+				lo = cmin[c];
+			if (cmax[c] > hi)
+				hi = cmax[c];
+		}
+
+		if (!(lo <= hi))
+			return;
+
+		if (lo == hi) {
+			lo -= 1;
+			hi += 1;
+		}
+	}
+
+	double scale = (H - 1) / (hi - lo);
+
+	fl_push_clip(X, Y, W, H);
+	fl_color(active_r() ? selection_color() : fl_inactive(selection_color()));
+
+	if (per_pixel >= 2.0) {
+		int prev_lo = 0, prev_hi = 0;
+		bool have_prev = false;
+
+		for (int c = 0; c < columns; c++) {
+			if (!(cmin[c] <= cmax[c])) {
+				have_prev = false;
+				continue;
+			}
+
+			int ylo = Y + H - 1 - (int)lrint((cmin[c] - lo) * scale);
+			int yhi = Y + H - 1 - (int)lrint((cmax[c] - lo) * scale);
+			int top = yhi, bottom = ylo;
+
+			// Reach over to the previous column so steep edges stay connected.
+			if (have_prev) {
+				if (top > prev_lo)
+					top = prev_lo;
+				if (bottom < prev_hi)
+					bottom = prev_hi;
+			}
+
+			fl_yxline(X + c, top, bottom);
+			prev_lo = ylo;
+			prev_hi = yhi;
+			have_prev = true;
+		}
+	} else {
+		double step = columns > 1 ? (double)(W - 1) / (columns - 1) : 0;
+
+		fl_begin_line();
+
+		for (int c = 0; c < columns; c++) {
+			if (cmin[c] != cmin[c]) {
+				fl_end_line();
+				fl_begin_line();
+				continue;
+			}
+
+			fl_vertex(X + c * step, Y + H - 1 - (cmin[c] - lo) * scale);
+		}
+
+		fl_end_line();
+	}
+
+	fl_pop_clip();
+}
+
+// Wheel zooms around the mouse, dragging pans.
+int Series_Chart::handle(int evt) {
+	long long first, count;
+
+	switch (evt) {
+	case FL_PUSH:
+		visible(&first, &count);
+		_drag_x = Fl::event_x();
+		_drag_first = first;
+		return 1;
+
+	case FL_DRAG: {
+		visible(&first, &count);
+
+		int W = w() - Fl::box_dw(box());
+		long long f = _drag_first - (long long)((double)(Fl::event_x() - _drag_x) * count / (W > 0 ? W : 1));
+
+		view(f < 0 ? 0 : f, count);
+		return 1;
+	}
+
+	case FL_MOUSEWHEEL: {
+		if (Fl::event_dy() == 0)
+			return 0;
+
+		visible(&first, &count);
+
+		int W = w() - Fl::box_dw(box());
+		double at = W > 0 ? (double)(Fl::event_x() - x() - Fl::box_dx(box())) / W : 0.5;
+		long long n = (long long)(count * (Fl::event_dy() > 0 ? 1.25 : 0.8));
+
+		if (n < 2)
+			n = 2;
+		if (n > _count)
+			n = _count;
+
+		long long f = first + (long long)((count - n) * at);
+		view(f < 0 ? 0 : f, n);
+		return 1;
+	}
+
+	default:
+		return Fl_Widget::handle(evt);
+	}
+}
+
+extern "C" Series_Chart* SeriesChart_Create(int x, int y, int w, int h, const char* label = 0) {
+	return new Series_Chart(x, y, w, h, label);
+}
+
+extern "C" void SeriesChart_SetData(Series_Chart* c, const void* samples, int type, long long count) {
+	c->data(samples, type, count);
+}
+
+extern "C" void SeriesChart_Append(Series_Chart* c, const void* samples, long long count) {
+	c->append(samples, count);
+}
+
+extern "C" void SeriesChart_SetView(Series_Chart* c, long long first, long long count) {
+	c->view(first, count);
+}
+
+extern "C" void SeriesChart_SetBounds(Series_Chart* c, double lo, double hi) {
+	c->bounds(lo, hi);
+}
+
+extern "C" void SeriesChart_Stats(Series_Chart* c, SeriesChartStats* stats) {
+	*stats = c->stats;
+}
@@ -0,0 +1,605 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/Fl_Text_Buffer.H>
+#include <Fl/Fl_Text_Display.H>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Syntax highlighting for Fl_Text_Display that keeps up with large files.
+//
+// The tokenizer is called one line at a time with the state the previous line
+// ended in (say, "inside a block comment") and returns the state this line ends
+// in. The state at the start of every line is kept, so an edit only restyles
+// from its own line on, and stops as soon as a line ends in the same state as
+// before and everything after it is known to follow from that state.
+//
+// Each edit restyles at most sync_lines lines on the spot (enough for what
+// is on screen). If the states haven't converged by then, the rest is restyled
+// in chunks of chunk_lines: a chunk is a snapshot of the text tagged with the
+// buffer version, tokenized on a worker thread (or in an idle callback when
+// the tokenizer isn't thread-safe), and applied to the style buffer unless an
+// edit touched its lines in the meantime; then it is redone from the new text.
+// Edits past its last line leave it valid, so steady typing further down
+// doesn't hold the background pass back. Finished chunks come back through
+// awake_post().
+//
+// New text is styled as "unfinished" until then. When the display runs into
+// unfinished text it asks for it through the unfinished-style callback, which
+// restyles the lines around it at once, from a possibly stale state when they
+// are far from what has been verified so far; the chunks correct them later.
+//
+// Two marks keep track of what can be trusted:
+//  - dirty_from: lines up to this one start in a verified state,
+//  - broken_max: past this line, every line's state follows from the previous
+//    line's (no edit or interrupted restyle left a gap in the chain).
+// A restyle that starts on a verified line and reproduces a stored state past
+// broken_max has therefore made the whole buffer correct.
+
+typedef int (*HighlightLineProc)(void* arg, const char* text, int length, int state, char* styles);
+
+struct HighlightStats {
+	long long sync_lines;    // lines tokenized on the UI thread
+	long long chunk_lines;   // lines tokenized in chunks
+	long long chunks;
+	long long stale_chunks;  // chunks dropped because the text changed
+	int lines;
+	int dirty_from;          // first line not verified yet (lines when done)
+};
+
+struct HighlightChunk {
+	unsigned id;
+	unsigned version;
+	int first;  // first line
+	int state;  // state at its start
+	HighlightLineProc tokenize;
+	void* arg;
+	std::string text;
+	std::string styles;
+	std::vector<int> states;  // state at the end of each line
+};
+
+class Highlighter {
+public:
+	Highlighter(Fl_Text_Display* display, Fl_Text_Buffer* text, const Fl_Text_Display::Style_Table_Entry* table,
+		int count, HighlightLineProc tokenize, void* arg, bool threaded);
+	~Highlighter();
+
+	void restyle_all();
+	void chunk_done(HighlightChunk* c);
+
+	int sync_lines = 200;
+	int chunk_lines = 4096;
+	HighlightStats stats = {};
+
+private:
+	static void modified(int pos, int inserted, int deleted, int restyled, const char* deleted_text, void* arg);
+	static void unfinished(int pos, void* arg);
+	static void idle(void* arg);
+	static void redisplay_later(void* arg);
+
+	int lines() const {
+		return (int)starts.size();
+	}
+
+	int line_of(int pos) const {
+		return (int)(std::upper_bound(starts.begin(), starts.end(), pos) - starts.begin()) - 1;
+	}
+
+	int line_end(int line) const {
+		return line + 1 < lines() ? starts[line + 1] - 1 : text->length();
+	}
+
+	void edit(int pos, int inserted, int deleted, const char* deleted_text);
+	void pass(int from, int until, bool drawing);
+	void schedule();
+	void redisplay(int start, int end, bool drawing);
+
+	Fl_Widget* display_widget;
+	Fl_Text_Display* display;
+	Fl_Text_Buffer* text;
+	Fl_Text_Buffer* style;
+	std::vector<Fl_Text_Display::Style_Table_Entry> table;
+	char unfinished_style;
+
+	HighlightLineProc tokenize;
+	void* arg;
+	bool threaded;
+
+	std::vector<int> starts;  // offset of each line
+	std::vector<int> states;  // state at the start of each line
+	int dirty_from = 0;
+	int broken_max = 0;
+
+	unsigned id;
+	unsigned version = 0;  // bumped when the chunk in flight becomes stale
+	int chunk_last = -1;   // last line of the chunk in flight
+	bool chunk_pending = false;
+
+	std::string line_styles;
+	std::string pass_styles;
+	std::string scratch;
+
+	int redisplay_start = -1, redisplay_end = -1;
+};
+
+// Pointers-to-member obtained through a derived class give access to the
+// protected highlighting state of Fl_Text_Display.
+struct TextDisplayAccess : public Fl_Text_Display {
+	static constexpr Fl_Text_Buffer* Fl_Text_Display::*style_buffer = &TextDisplayAccess::mStyleBuffer;
+	static constexpr Unfinished_Style_Cb Fl_Text_Display::*unfinished_cb = &TextDisplayAccess::mUnfinishedHighlightCB;
+	static constexpr int Fl_Text_Display::*style_count = &TextDisplayAccess::mNStyles;
+};
+
+// Highlighters by id, so chunks finishing after Highlighter_Destroy are dropped.
+static std::unordered_map<unsigned, Highlighter*> live;
+static unsigned next_id = 1;
+
+// Never destroyed: the worker thread may still be waiting on it at exit.
+struct HighlightWorker {
+	std::mutex lock;
+	std::condition_variable wake;
+	std::deque<HighlightChunk*> jobs;
+	std::deque<HighlightChunk*> done;
+	std::condition_variable finished;
+	unsigned running;  // id of the highlighter whose chunk is being tokenized
+	bool started;
+};
+
+static void chunks_done(void*);
+
+static HighlightWorker& worker = *new HighlightWorker();
+static AwakePost& worker_done = *new AwakePost{ chunks_done, nullptr };
+
+// Tokenizes the lines of c->text, recording the state each one ends in.
+static void run_chunk(HighlightChunk* c) {
+	const char* p = c->text.data();
+	const char* end = p + c->text.size();
+	int state = c->state;
+
+	c->styles.resize(c->text.size());
+	c->states.clear();
+
+	do {
+		const char* nl = (const char*)memchr(p, '\n', end - p);
+		int len = (int)((nl != nullptr ? nl : end) - p);
+		char* out = &c->styles[p - c->text.data()];
+
+		state = c->tokenize(c->arg, p, len, state, out);
+		c->states.push_back(state);
+
+		if (nl == nullptr)
+			break;
+
+		out[len] = 'A';
+		p = nl + 1;
+	} while (p < end);
+}
+
+static void chunks_done(void*) {
+	std::deque<HighlightChunk*> done;
+
+	awake_drained(worker_done);
+
+	{
+		std::lock_guard<std::mutex> guard(worker.lock);
+		done.swap(worker.done);
+	}
+
+	for (HighlightChunk* c : done) {
+		auto it = live.find(c->id);
+
+		if (it != live.end())
+			it->second->chunk_done(c);
+
+		delete c;
+	}
+}
+
+static void highlight_worker() {
+	std::unique_lock<std::mutex> guard(worker.lock);
+
+	for (;;) {
+		worker.wake.wait(guard, [] { return !worker.jobs.empty(); });
+
+		HighlightChunk* c = worker.jobs.front();
+		worker.jobs.pop_front();
+		worker.running = c->id;
+		guard.unlock();
+
+		run_chunk(c);
+
+		guard.lock();
+		worker.running = 0;
+		worker.finished.notify_all();
+		worker.done.push_back(c);
+		guard.unlock();
+
+		awake_post(worker_done);
+		guard.lock();
+	}
+}
+
+Highlighter::Highlighter(Fl_Text_Display* display, Fl_Text_Buffer* text, const Fl_Text_Display::Style_Table_Entry* table,
+		int count, HighlightLineProc tokenize, void* arg, bool threaded):
+		display_widget(display), display(display), text(text), table(table, table + count),
+		tokenize(tokenize), arg(arg), threaded(threaded) {
+	// One more entry, same as the first, for text that isn't styled yet.
+	this->table.push_back(table[0]);
+	unfinished_style = (char)('A' + count);
+
+	style = new Fl_Text_Buffer(text->length() + 1);
+	style->canUndo(0);
+
+	id = next_id++;
+	live[id] = this;
+
+	Fl::watch_widget_pointer(display_widget);
+	display->highlight_data(style, this->table.data(), (int)this->table.size(), unfinished_style, unfinished, this);
+	text->add_modify_callback(modified, this);
+
+	restyle_all();
+}
+
+Highlighter::~Highlighter() {
+	live.erase(id);
+	text->remove_modify_callback(modified, this);
+	Fl::remove_idle(idle, this);
+	Fl::remove_timeout(redisplay_later, this);
+
+	// The tokenizer's arg may go away with us: drop queued chunks and wait for
+	// a running one.
+	{
+		std::unique_lock<std::mutex> guard(worker.lock);
+
+		for (auto it = worker.jobs.begin(); it != worker.jobs.end();) {
+			if ((*it)->id == id) {
+				delete *it;
+				it = worker.jobs.erase(it);
+			} else {
+				++it;
+			}
+		}
+
+		worker.finished.wait(guard, [this] { return worker.running != id; });
+	}
+
+	// Turn highlighting off in a display that outlives us.
+	if (display_widget != nullptr) {
+		display->*TextDisplayAccess::style_buffer = nullptr;
+		display->*TextDisplayAccess::unfinished_cb = nullptr;
+		display->*TextDisplayAccess::style_count = 0;
+		display->redraw();
+	}
+
+	Fl::release_widget_pointer(display_widget);
+	delete style;
+}
+
+// Throws away all styles and states, e.g. after the tokenizer's rules changed.
+void Highlighter::restyle_all() {
+	int n = text->length();
+	std::string fill(n, unfinished_style);
+	const char* part[2];
+	int len[2];
+
+	version++;
+	starts.assign(1, 0);
+
+	TextBuffer_Slices(text, 0, n, &part[0], &len[0], &part[1], &len[1]);
+
+	for (int i = 0, offset = 0; i < 2; offset += len[i], i++) {
+		for (const char* p = part[i]; (p = (const char*)memchr(p, '\n', part[i] + len[i] - p)) != nullptr; p++)
+			starts.push_back(offset + (int)(p - part[i]) + 1);
+	}
+
+	states.assign(starts.size(), 0);
+	dirty_from = 0;
+	broken_max = lines();
+
+	TextBuffer_Replace(style, 0, style->length(), fill.data(), n);
+	pass(0, 0, false);
+}
+
+void Highlighter::modified(int pos, int inserted, int deleted, int, const char* deleted_text, void* arg) {
+	if (inserted != 0 || deleted != 0)
+		((Highlighter*)arg)->edit(pos, inserted, deleted, deleted_text);
+}
+
+void Highlighter::edit(int pos, int inserted, int deleted, const char* deleted_text) {
+	int line = line_of(pos);
+	int removed = 0;
+	std::vector<int> added;
+
+	if (line <= chunk_last)
+		version++;
+
+	if (deleted_text != nullptr) {
+		for (const char* p = deleted_text; (p = strchr(p, '\n')) != nullptr; p++)
+			removed++;
+	}
+
+	for (int p = pos; p < pos + inserted; p++) {
+		if (text->byte_at(p) == '\n')
+			added.push_back(p + 1);
+	}
+
+	starts.erase(starts.begin() + line + 1, starts.begin() + line + 1 + removed);
+	states.erase(states.begin() + line + 1, states.begin() + line + 1 + removed);
+
+	for (size_t i = line + 1; i < starts.size(); i++)
+		starts[i] += inserted - deleted;
+
+	starts.insert(starts.begin() + line + 1, added.begin(), added.end());
+	states.insert(states.begin() + line + 1, added.size(), 0);
+
+	int delta = (int)added.size() - removed;
+
+	if (dirty_from > line)
+		dirty_from = std::max(line + 1, dirty_from + delta);
+	if (broken_max > line)
+		broken_max = std::max(line, broken_max + delta);
+
+	// The edited lines no longer follow from the states before them.
+	broken_max = std::max(broken_max, line + (int)added.size());
+
+	std::string fill(inserted, unfinished_style);
+	TextBuffer_Replace(style, pos, pos + deleted, fill.data(), inserted);
+
+	pass(line, line + (int)added.size(), false);
+}
+
+// Restyles from line from through at least until, continuing until the states
+// converge or sync_lines lines were done, and updates the marks.
+void Highlighter::pass(int from, int until, bool drawing) {
+	int n = lines();
+	int line = from;
+	int state = states[from];
+	bool verified = from <= dirty_from;
+	bool converged = false;
+
+	pass_styles.clear();
+
+	while (line < n) {
+		const char *first, *second;
+		int first_len, second_len;
+		int start = starts[line], end = line_end(line);
+		const char* p;
+
+		// A line split by the gap is copied; the rest are read in place.
+		TextBuffer_Slices(text, start, end, &first, &first_len, &second, &second_len);
+
+		if (second_len == 0) {
+			p = first;
+		} else {
+			scratch.assign(first, first_len);
+			scratch.append(second, second_len);
+			p = scratch.data();
+		}
+
+		line_styles.resize(end - start);
+		state = tokenize(arg, p, end - start, state, &line_styles[0]);
+		pass_styles += line_styles;
+		stats.sync_lines++;
+		line++;
+
+		if (line == n)
+			break;
+
+		pass_styles += 'A';
+
+		bool same = states[line] == state;
+		states[line] = state;
+
+		if (same && line > broken_max && line > until) {
+			converged = true;
+			break;
+		}
+
+		if (line > until && line - from >= sync_lines)
+			break;
+	}
+
+	int start = starts[from];
+	int end = start + (int)pass_styles.size();
+
+	TextBuffer_Replace(style, start, end, pass_styles.data(), (int)pass_styles.size());
+	redisplay(start, end, drawing);
+
+	if (line == n || converged) {
+		if (verified) {
+			dirty_from = n;
+			broken_max = -1;
+		}
+	} else {
+		broken_max = std::max(broken_max, line);
+
+		if (verified)
+			dirty_from = line;
+	}
+
+	schedule();
+}
+
+// The display draws text nobody styled yet: style it now.
+void Highlighter::unfinished(int pos, void* arg) {
+	Highlighter* h = (Highlighter*)arg;
+	int line = h->line_of(pos);
+
+	if (line - h->dirty_from <= h->sync_lines)
+		h->pass(std::min(h->dirty_from, line), line, true);
+	else
+		h->pass(line, line, true);
+}
+
+// Styles changed by the unfinished-style callback are redisplayed after the
+// current draw instead of from inside it.
+void Highlighter::redisplay(int start, int end, bool drawing) {
+	if (display_widget == nullptr || start >= end)
+		return;
+
+	if (!drawing) {
+		display->redisplay_range(start, end);
+		return;
+	}
+
+	if (redisplay_start < 0)
+		Fl::add_timeout(0.0, redisplay_later, this);
+
+	redisplay_start = redisplay_start < 0 ? start : std::min(redisplay_start, start);
+	redisplay_end = std::max(redisplay_end, end);
+}
+
+void Highlighter::redisplay_later(void* arg) {
+	Highlighter* h = (Highlighter*)arg;
+	int start = h->redisplay_start, end = std::min(h->redisplay_end, h->text->length());
+
+	h->redisplay_start = h->redisplay_end = -1;
+
+	if (h->display_widget != nullptr && start < end)
+		h->display->redisplay_range(start, end);
+}
+
+void Highlighter::schedule() {
+	stats.lines = lines();
+	stats.dirty_from = dirty_from;
+
+	if (chunk_pending || dirty_from >= lines())
+		return;
+
+	if (!threaded) {
+		Fl::add_idle(idle, this);
+		chunk_pending = true;
+		return;
+	}
+
+	HighlightChunk* c = new HighlightChunk();
+	int last = std::min(dirty_from + chunk_lines, lines()) - 1;
+	int end = last + 1 < lines() ? starts[last + 1] : text->length();
+	const char *first, *second;
+	int first_len, second_len;
+
+	c->id = id;
+	c->version = version;
+	c->first = dirty_from;
+	c->state = states[dirty_from];
+	c->tokenize = tokenize;
+	c->arg = arg;
+	chunk_last = last;
+
+	TextBuffer_Slices(text, starts[dirty_from], end, &first, &first_len, &second, &second_len);
+	c->text.reserve(first_len + second_len);
+	c->text.assign(first, first_len);
+	c->text.append(second, second_len);
+
+	chunk_pending = true;
+	stats.chunks++;
+
+	std::lock_guard<std::mutex> guard(worker.lock);
+
+	worker.jobs.push_back(c);
+
+	if (!worker.started) {
+		std::thread(highlight_worker).detach();
+		worker.started = true;
+	}
+
+	worker.wake.notify_one();
+}
+
+// Unthreaded mode: one chunk per idle call, run in place.
+void Highlighter::idle(void* arg) {
+	Highlighter* h = (Highlighter*)arg;
+
+	Fl::remove_idle(idle, h);
+	h->chunk_pending = false;
+
+	if (h->dirty_from < h->lines()) {
+		int first = h->dirty_from;
+		int sync = h->sync_lines;
+
+		h->sync_lines = h->chunk_lines;
+		h->pass(first, first, false);
+		h->sync_lines = sync;
+	}
+}
+
+void Highlighter::chunk_done(HighlightChunk* c) {
+	int n = lines();
+
+	chunk_pending = false;
+	chunk_last = -1;
+
+	if (c->version != version || c->first != dirty_from) {
+		stats.stale_chunks++;
+		schedule();
+		return;
+	}
+
+	int line = c->first;
+	bool converged = false;
+
+	for (size_t i = 0; i < c->states.size(); i++) {
+		line++;
+		stats.chunk_lines++;
+
+		if (line >= n)
+			break;
+
+		bool same = states[line] == c->states[i];
+		states[line] = c->states[i];
+
+		if (same && line > broken_max) {
+			converged = true;
+			break;
+		}
+	}
+
+	int start = starts[c->first];
+	int end = line < n ? starts[line] : text->length();
+
+	TextBuffer_Replace(style, start, end, c->styles.data(), end - start);
+	redisplay(start, end, false);
+
+	if (line >= n || converged) {
+		dirty_from = n;
+		broken_max = -1;
+	} else {
+		dirty_from = line;
+		broken_max = std::max(broken_max, line);
+	}
+
+	schedule();
+}
+
+extern "C" Highlighter* Highlighter_Create(Fl_Text_Display* display, Fl_Text_Buffer* text,
+		const Fl_Text_Display::Style_Table_Entry* table, int count, HighlightLineProc tokenize, void* arg, int threaded) {
+	if (count <= 0 || count > 'z' - 'A')
+		return nullptr;
+
+	return new Highlighter(display, text, table, count, tokenize, arg, threaded != 0);
+}
+
+extern "C" void Highlighter_Configure(Highlighter* h, int sync_lines, int chunk_lines) {
+	if (sync_lines > 0)
+		h->sync_lines = sync_lines;
+	if (chunk_lines > 0)
+		h->chunk_lines = chunk_lines;
+}
+
+extern "C" void Highlighter_RestyleAll(Highlighter* h) {
+	h->restyle_all();
+}
+
+extern "C" void Highlighter_Stats(Highlighter* h, HighlightStats* stats) {
+	*stats = h->stats;
+}
+
+extern "C" void Highlighter_Destroy(Highlighter* h) {
+	delete h;
+}
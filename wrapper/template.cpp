@@ -1,15 +1,41 @@
 //HEAD
 #include <Fl/Fl.H>
+#include <Fl/fl_draw.H>
 #include <stdio.h>
+#include "fltk_d_wrapper.h"
 
 //BODY
 #include <Fl/Fl_!WIDGET_NAME!.H>
 class Custom!WIDGET_NAME!: public Fl_!WIDGET_NAME! {
 public:
 	Custom!WIDGET_NAME!(int x, int y, int w, int h, const char* label = 0);
+	~Custom!WIDGET_NAME!();
 
 	int (*_handle)(Custom!WIDGET_NAME!*, int) = nullptr;
 	void (*_draw)(Custom!WIDGET_NAME!*) = nullptr;
+	// Same as _draw, plus damage() and the part of the widget inside the clip region
+	void (*_draw_ex)(Custom!WIDGET_NAME!*, int damage, int X, int Y, int W, int H) = nullptr;
+
+	// Retained draw commands, replayed without calling into D (see draw_buffer.cpp).
+	// A copy: the D array may be reallocated or collected after SetDrawBuffer.
+	std::vector<int> _draw_words;
+	bool _draw_buffer = false;
+
+	// Events (EVENT_BIT) passed to _handle; the rest go straight to the base
+	// class. Coalesced ones are delivered once per frame (see event_filter.cpp).
+	uint64_t _event_mask = ~(uint64_t)0;
+	uint64_t _coalesce_mask = 0;
+	PendingEvents _pending = {};
+
+	static int deliver_event(void* w, int evt);
+
+	// Offscreen copy of the widget, when retained (see retained_surface.cpp)
+	bool _retained = false;
+	bool _rendering = false;
+	RetainedSurface _surface = {};
+
+	// Draw buffer rasterized on a worker thread, when async (see async_raster.cpp)
+	AsyncRaster* _async = nullptr;
 
 	void real_draw();
 	int real_handle(int evt);
@@ -21,7 +47,36 @@ public:
 Custom!WIDGET_NAME!::Custom!WIDGET_NAME!(int x, int y, int w, int h, const char* label): Fl_!WIDGET_NAME!(x, y, w, h, label) {
 }
 
+Custom!WIDGET_NAME!::~Custom!WIDGET_NAME!() {
+	EventFilter_Cancel(&_pending);
+	RetainedSurface_Free(&_surface);
+	AsyncRaster_Free(_async);
+	CallbackRegistry_ReleaseTree(this, 0);
+}
+
 void Custom!WIDGET_NAME!::draw() {
+	if (_async != NULL) {
+		AsyncRaster_Draw(_async, this);
+		return;
+	}
+
+	if (_retained && !_rendering) {
+		RetainedSurface_Draw(&_surface, this, &_rendering);
+		return;
+	}
+
+	if (_draw_buffer) {
+		DrawBuffer_Replay(_draw_words.data(), _draw_words.size());
+		return;
+	}
+
+	if (_draw_ex != NULL) {
+		int X, Y, W, H;
+
+		fl_clip_box(x(), y(), w(), h(), X, Y, W, H);
+		return _draw_ex(this, _rendering ? FL_DAMAGE_ALL : damage(), X, Y, W, H);
+	}
+
 	if (_draw != NULL)
 		return _draw(this);
 
@@ -30,10 +85,20 @@ void Custom!WIDGET_NAME!::draw() {
 }
 
 int Custom!WIDGET_NAME!::handle(int evt) {
-	if (_handle != NULL)
-		return _handle(this, evt);
+	if (_handle == NULL || !(_event_mask & EVENT_BIT(evt)))
+		return Fl_!WIDGET_NAME!::handle(evt);
 
-	return Fl_!WIDGET_NAME!::handle(evt);
+	if (_coalesce_mask & EVENT_BIT(evt))
+		return EventFilter_Coalesce(&_pending, this, deliver_event, evt);
+
+	EventFilter_Flush(&_pending);
+	return _handle(this, evt);
+}
+
+int Custom!WIDGET_NAME!::deliver_event(void* w, int evt) {
+	Custom!WIDGET_NAME!* b = (Custom!WIDGET_NAME!*)w;
+
+	return b->_handle != NULL ? b->_handle(b, evt) : 0;
 }
 
 void Custom!WIDGET_NAME!::real_draw() {
@@ -52,10 +117,81 @@ extern "C" void Custom!WIDGET_NAME!_SetHandle(Custom!WIDGET_NAME!* b, int (*hand
 	b->_handle = handler;
 }
 
+extern "C" void Custom!WIDGET_NAME!_SetEventMask(Custom!WIDGET_NAME!* b, uint64_t mask, uint64_t coalesce) {
+	EventFilter_Flush(&b->_pending);
+
+	b->_event_mask = mask;
+	b->_coalesce_mask = coalesce & mask;
+}
+
+extern "C" int Custom!WIDGET_NAME!_CoalescedCount(Custom!WIDGET_NAME!* b) {
+	return b->_pending.delivered;
+}
+
 extern "C" void Custom!WIDGET_NAME!_SetDraw(Custom!WIDGET_NAME!* b, void (*draw)(Custom!WIDGET_NAME!* b)) {
 	b->_draw = draw;
 }
 
+extern "C" void Custom!WIDGET_NAME!_SetDrawEx(Custom!WIDGET_NAME!* b, void (*draw)(Custom!WIDGET_NAME!* b, int damage, int X, int Y, int W, int H)) {
+	b->_draw_ex = draw;
+}
+
+extern "C" void Custom!WIDGET_NAME!_SetDrawBuffer(Custom!WIDGET_NAME!* b, const int* words, size_t count) {
+	b->_draw_buffer = words != NULL;
+	b->_draw_words.assign(words, words + (words != NULL ? count : 0));
+	RetainedSurface_Invalidate(&b->_surface);
+	b->redraw();
+}
+
+extern "C" void Custom!WIDGET_NAME!_SetRetained(Custom!WIDGET_NAME!* b, int retained) {
+	b->_retained = retained != 0;
+
+	if (!b->_retained)
+		RetainedSurface_Free(&b->_surface);
+
+	b->redraw();
+}
+
+// Makes a retained widget render itself again on its next draw().
+extern "C" void Custom!WIDGET_NAME!_Invalidate(Custom!WIDGET_NAME!* b) {
+	RetainedSurface_Invalidate(&b->_surface);
+	b->redraw();
+}
+
+extern "C" void Custom!WIDGET_NAME!_RetainedStats(Custom!WIDGET_NAME!* b, long long* renders, long long* blits) {
+	*renders = b->_surface.renders;
+	*blits = b->_surface.blits;
+}
+
+extern "C" void Custom!WIDGET_NAME!_SetAsync(Custom!WIDGET_NAME!* b, int async) {
+	if (async && b->_async == NULL) {
+		b->_async = AsyncRaster_Create(b);
+	} else if (!async) {
+		AsyncRaster_Free(b->_async);
+		b->_async = NULL;
+	}
+
+	b->redraw();
+}
+
+// Hands a draw buffer to the worker; the words are copied. draw() shows the
+// previous frame until this one is rasterized.
+extern "C" void Custom!WIDGET_NAME!_SubmitFrame(Custom!WIDGET_NAME!* b, const int* words, size_t count) {
+	if (b->_async != NULL)
+		AsyncRaster_Submit(b->_async, b, words, count);
+}
+
+extern "C" void Custom!WIDGET_NAME!_AsyncStats(Custom!WIDGET_NAME!* b, AsyncRasterStats* stats) {
+	if (b->_async != NULL)
+		AsyncRaster_Stats(b->_async, stats);
+	else
+		*stats = {};
+}
+
+extern "C" void Custom!WIDGET_NAME!_SetCallback(Custom!WIDGET_NAME!* b, void* cb, void* arg) {
+	CallbackRegistry_SetOwned(b, cb, arg);
+}
+
 extern "C" void Custom!WIDGET_NAME!_RealDraw(Custom!WIDGET_NAME!* b) {
 	b->real_draw();
 }
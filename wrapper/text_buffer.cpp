@@ -0,0 +1,201 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/Fl_Text_Buffer.H>
+#include <stdlib.h>
+#include <string.h>
+
+// Copy-free access to Fl_Text_Buffer for the D bindings.
+//
+// Reads hand out the gap buffer itself as (at most) two slices instead of the
+// malloc'd copies returned by text(), text_range() and friends. Writes take
+// pointer/length pairs, so D slices don't need a NUL-terminated copy.
+//
+// Buffers with undo turned off (canUndo(0)) are written straight into the gap.
+// The undo bookkeeping lives in file-static state inside FLTK, so buffers that
+// keep undo go through insert_() with a reused scratch copy instead.
+
+// Pointers-to-member obtained through a derived class give well-defined access
+// to the protected parts of Fl_Text_Buffer.
+struct TextBufferAccess : public Fl_Text_Buffer {
+	static constexpr char* Fl_Text_Buffer::*buf = &TextBufferAccess::mBuf;
+	static constexpr int Fl_Text_Buffer::*gap_start = &TextBufferAccess::mGapStart;
+	static constexpr int Fl_Text_Buffer::*gap_end = &TextBufferAccess::mGapEnd;
+	static constexpr int Fl_Text_Buffer::*length = &TextBufferAccess::mLength;
+	static constexpr int Fl_Text_Buffer::*cursor_pos_hint = &TextBufferAccess::mCursorPosHint;
+	static constexpr int Fl_Text_Buffer::*preferred_gap_size = &TextBufferAccess::mPreferredGapSize;
+	static constexpr char Fl_Text_Buffer::*can_undo = &TextBufferAccess::mCanUndo;
+
+	static constexpr void (Fl_Text_Buffer::*move_gap_)(int) = &TextBufferAccess::move_gap;
+	static constexpr void (Fl_Text_Buffer::*reallocate_with_gap_)(int, int) = &TextBufferAccess::reallocate_with_gap;
+	static constexpr void (Fl_Text_Buffer::*update_selections_)(int, int, int) = &TextBufferAccess::update_selections;
+	static constexpr int (Fl_Text_Buffer::*insert_text_)(int, const char*) = &TextBufferAccess::insert_;
+	static constexpr void (Fl_Text_Buffer::*remove_text_)(int, int) = &TextBufferAccess::remove_;
+	static constexpr void (Fl_Text_Buffer::*call_predelete_)(int, int) const = &TextBufferAccess::call_predelete_callbacks;
+	static constexpr void (Fl_Text_Buffer::*call_modify_)(int, int, int, int, const char*) const = &TextBufferAccess::call_modify_callbacks;
+};
+
+typedef TextBufferAccess A;
+
+static char* scratch = nullptr;
+static size_t scratch_size = 0;
+
+static const char* terminated_copy(const char* text, int len) {
+	if (scratch_size < (size_t)len + 1) {
+		scratch_size = (size_t)len + 1 > scratch_size * 2 ? (size_t)len + 1 : scratch_size * 2;
+		scratch = (char*)realloc(scratch, scratch_size);
+	}
+
+	memcpy(scratch, text, len);
+	scratch[len] = 0;
+	return scratch;
+}
+
+static int clamp_pos(Fl_Text_Buffer* b, int pos) {
+	if (pos < 0)
+		return 0;
+
+	return pos > b->length() ? b->length() : pos;
+}
+
+// Non-redisplaying insert of len bytes at pos, the slice counterpart of insert_().
+static int insert_slice(Fl_Text_Buffer* b, int pos, const char* text, int len) {
+	if (len <= 0)
+		return 0;
+
+	if (b->*A::can_undo)
+		return (b->*A::insert_text_)(pos, terminated_copy(text, len));
+
+	if (len > b->*A::gap_end - b->*A::gap_start)
+		(b->*A::reallocate_with_gap_)(pos, len + b->*A::preferred_gap_size);
+	else if (pos != b->*A::gap_start)
+		(b->*A::move_gap_)(pos);
+
+	memcpy(b->*A::buf + pos, text, len);
+	b->*A::gap_start += len;
+	b->*A::length += len;
+	(b->*A::update_selections_)(pos, 0, len);
+	return len;
+}
+
+// Returns [start, end) as the part before the gap and the part after it.
+// Either slice may be empty. Valid until the buffer is next modified.
+extern "C" void TextBuffer_Slices(Fl_Text_Buffer* b, int start, int end,
+		const char** first, int* first_len, const char** second, int* second_len) {
+	start = clamp_pos(b, start);
+	end = clamp_pos(b, end);
+
+	if (end < start)
+		end = start;
+
+	int gap = b->*A::gap_start;
+
+	if (end <= gap || start >= gap) {
+		*first = b->address(start);
+		*first_len = end - start;
+		*second = nullptr;
+		*second_len = 0;
+		return;
+	}
+
+	*first = b->address(start);
+	*first_len = gap - start;
+	*second = b->address(gap);
+	*second_len = end - gap;
+}
+
+extern "C" void TextBuffer_LineSlices(Fl_Text_Buffer* b, int pos,
+		const char** first, int* first_len, const char** second, int* second_len) {
+	TextBuffer_Slices(b, b->line_start(pos), b->line_end(pos), first, first_len, second, second_len);
+}
+
+extern "C" void TextBuffer_SelectionSlices(Fl_Text_Buffer* b,
+		const char** first, int* first_len, const char** second, int* second_len) {
+	int start, end;
+
+	if (!b->selection_position(&start, &end))
+		start = end = 0;
+
+	TextBuffer_Slices(b, start, end, first, first_len, second, second_len);
+}
+
+// Moves the gap out of [start, end), toward whichever side needs less copying,
+// and returns the range as one slice.
+extern "C" const char* TextBuffer_Contiguous(Fl_Text_Buffer* b, int start, int end) {
+	start = clamp_pos(b, start);
+	end = clamp_pos(b, end);
+
+	int gap = b->*A::gap_start;
+
+	if (start < gap && gap < end)
+		(b->*A::move_gap_)(gap - start < end - gap ? start : end);
+
+	return b->address(start);
+}
+
+// Makes room for extra bytes at the end of the buffer, so large appends that
+// arrive in pieces don't reallocate and copy the whole buffer each time.
+extern "C" void TextBuffer_Reserve(Fl_Text_Buffer* b, int extra) {
+	int len = b->length();
+
+	if (b->*A::gap_end - b->*A::gap_start < extra)
+		(b->*A::reallocate_with_gap_)(len, extra);
+	else if (b->*A::gap_start != len)
+		(b->*A::move_gap_)(len);
+}
+
+extern "C" void TextBuffer_Insert(Fl_Text_Buffer* b, int pos, const char* text, int len) {
+	if (len <= 0)
+		return;
+
+	pos = clamp_pos(b, pos);
+	(b->*A::call_predelete_)(pos, 0);
+
+	int inserted = insert_slice(b, pos, text, len);
+
+	b->*A::cursor_pos_hint = pos + inserted;
+	(b->*A::call_modify_)(pos, 0, inserted, 0, nullptr);
+}
+
+extern "C" void TextBuffer_Append(Fl_Text_Buffer* b, const char* text, int len) {
+	TextBuffer_Insert(b, b->length(), text, len);
+}
+
+// Appends many slices with one modify notification, so displays relayout once.
+extern "C" void TextBuffer_AppendSlices(Fl_Text_Buffer* b, const DSlice* slices, size_t count) {
+	int pos = b->length();
+	int inserted = 0;
+
+	(b->*A::call_predelete_)(pos, 0);
+
+	for (size_t i = 0; i < count; i++)
+		inserted += insert_slice(b, pos + inserted, slices[i].ptr, (int)slices[i].length);
+
+	if (inserted == 0)
+		return;
+
+	b->*A::cursor_pos_hint = pos + inserted;
+	(b->*A::call_modify_)(pos, 0, inserted, 0, nullptr);
+}
+
+extern "C" void TextBuffer_Replace(Fl_Text_Buffer* b, int start, int end, const char* text, int len) {
+	start = clamp_pos(b, start);
+	end = clamp_pos(b, end);
+
+	if (end < start) {
+		int t = start;
+		start = end;
+		end = t;
+	}
+
+	(b->*A::call_predelete_)(start, end - start);
+
+	// Modify callbacks expect the removed text as a C string.
+	char* deleted = b->text_range(start, end);
+
+	(b->*A::remove_text_)(start, end);
+
+	int inserted = insert_slice(b, start, text, len);
+
+	b->*A::cursor_pos_hint = start + inserted;
+	(b->*A::call_modify_)(start, end - start, inserted, 0, deleted);
+	free(deleted);
+}
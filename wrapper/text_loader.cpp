@@ -0,0 +1,195 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/Fl_Text_Buffer.H>
+#include <Fl/fl_utf8.h>
+#include <stdio.h>
+#include <errno.h>
+#include <chrono>
+#include <vector>
+
+// Streaming replacement for Fl_Text_Buffer::loadfile()/appendfile().
+//
+// The file is read in chunks from an idle callback, so the event loop keeps
+// running (and any attached Fl_Text_Display keeps scrolling and repainting)
+// while the text arrives. Each step reads chunks for at most a few
+// milliseconds before returning to the loop.
+//
+// Transcoding is done per chunk: valid UTF-8 is appended as is, anything else
+// is treated like insertfile() does (CP1252 via fl_utf8decode) and flagged in
+// input_file_was_transcoded. A multi-byte sequence cut by the chunk boundary
+// is carried over to the next chunk.
+//
+// The buffer is grown once to the file size up front, so the load doesn't
+// reallocate and copy the buffer per chunk.
+
+#define TEXT_LOADER_STEP_MS 8
+
+typedef void (*TextLoaderProgressProc)(void* data, long long loaded, long long total, int status);
+
+struct TextLoader {
+	Fl_Text_Buffer* buffer;
+	FILE* file;
+	long long loaded;
+	long long total;
+	int transcoded;
+
+	std::vector<char> chunk;
+	std::vector<char> out;
+	int carry;
+
+	TextLoaderProgressProc progress;
+	void* data;
+};
+
+static void text_loader_step(void* data);
+
+static void text_loader_finish(TextLoader* l, int status) {
+	Fl::remove_idle(text_loader_step, l);
+	fclose(l->file);
+
+	if (status == 0 && l->transcoded) {
+		l->buffer->input_file_was_transcoded = 1;
+		if (l->buffer->transcoding_warning_action)
+			l->buffer->transcoding_warning_action(l->buffer);
+	}
+
+	if (l->progress != nullptr)
+		l->progress(l->data, l->loaded, l->total, status);
+
+	delete l;
+}
+
+// Appends [p, e) to the buffer, transcoding invalid UTF-8. Returns the number
+// of trailing bytes of an incomplete sequence left for the next chunk.
+static int text_loader_append(TextLoader* l, const char* p, const char* e, bool eof) {
+	const char* start = p;
+	const char* valid = p;  // start of the pending run of valid bytes
+	int carry = 0;
+
+	l->out.clear();
+
+	while (p < e) {
+		unsigned char c = (unsigned char)*p;
+
+		if (c < 0x80) {
+			p++;
+			continue;
+		}
+
+		int expected = fl_utf8len(*p);
+
+		if (expected > 1 && e - p < expected && !eof) {
+			carry = (int)(e - p);
+			break;
+		}
+
+		int len;
+		unsigned ucs = fl_utf8decode(p, e, &len);
+
+		if (len > 1) {
+			p += len;
+			continue;
+		}
+
+		// Invalid byte: flush the valid run and append its CP1252 mapping.
+		char enc[4];
+		int n = fl_utf8encode(ucs, enc);
+
+		l->out.insert(l->out.end(), valid, p);
+		l->out.insert(l->out.end(), enc, enc + n);
+		l->transcoded = 1;
+		p++;
+		valid = p;
+	}
+
+	if (l->out.empty()) {
+		TextBuffer_Append(l->buffer, start, (int)(p - start));
+	} else {
+		l->out.insert(l->out.end(), valid, p);
+		TextBuffer_Append(l->buffer, l->out.data(), (int)l->out.size());
+	}
+
+	return carry;
+}
+
+static void text_loader_step(void* data) {
+	TextLoader* l = (TextLoader*)data;
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TEXT_LOADER_STEP_MS);
+
+	do {
+		size_t n = fread(l->chunk.data() + l->carry, 1, l->chunk.size() - l->carry, l->file);
+
+		if (n == 0 && ferror(l->file)) {
+			text_loader_finish(l, errno ? errno : EIO);
+			return;
+		}
+
+		bool eof = n == 0 || feof(l->file);
+		const char* p = l->chunk.data();
+		const char* e = p + l->carry + n;
+
+		l->loaded += n;
+
+		int carry = text_loader_append(l, p, e, eof);
+
+		// Keep the cut sequence at the front of the next chunk.
+		for (int i = 0; i < carry; i++)
+			l->chunk[i] = e[i - carry];
+		l->carry = carry;
+
+		if (eof) {
+			text_loader_finish(l, 0);
+			return;
+		}
+	} while (std::chrono::steady_clock::now() < deadline);
+
+	if (l->progress != nullptr)
+		l->progress(l->data, l->loaded, l->total, 1);
+}
+
+// Starts loading file into b and returns the loader, or nullptr (with errno
+// set) if the file can't be opened. Unless append is set the buffer is
+// cleared first. progress is called after every step with status 1, then once
+// more with 0 on success or an errno value on failure; the loader is freed
+// after that last call. The buffer must outlive the loader or be cancelled.
+extern "C" TextLoader* TextLoader_Start(Fl_Text_Buffer* b, const char* filename, int append,
+		int chunk_size, TextLoaderProgressProc progress, void* data) {
+	FILE* f = fl_fopen(filename, "rb");
+
+	if (f == nullptr)
+		return nullptr;
+
+	TextLoader* l = new TextLoader();
+
+	l->buffer = b;
+	l->file = f;
+	l->loaded = 0;
+	l->total = 0;
+	l->transcoded = 0;
+	l->carry = 0;
+	l->progress = progress;
+	l->data = data;
+	l->chunk.resize((chunk_size > 0 ? chunk_size : 1024 * 1024) + 4);
+
+	if (fseek(f, 0, SEEK_END) == 0) {
+		l->total = ftell(f);
+		fseek(f, 0, SEEK_SET);
+	}
+
+	if (!append)
+		b->remove(0, b->length());
+
+	b->input_file_was_transcoded = 0;
+
+	if (l->total > 0)
+		TextBuffer_Reserve(b, (int)l->total);
+
+	Fl::add_idle(text_loader_step, l);
+	return l;
+}
+
+// Stops a running load and frees the loader without calling progress again.
+// The text loaded so far stays in the buffer.
+extern "C" void TextLoader_Cancel(TextLoader* l) {
+	l->progress = nullptr;
+	text_loader_finish(l, ECANCELED);
+}
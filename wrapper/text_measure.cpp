@@ -0,0 +1,211 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/fl_draw.H>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+
+// Cache for fl_width() / fl_measure() results.
+//
+// Both go to the graphics driver (and on X11 to Xft) on every call, while
+// widgets keep measuring the same labels on every redraw. Results are cached
+// per (font, size) on a 64-bit hash of the string, with the string itself kept
+// to rule out collisions.
+//
+// Each (font, size) keeps two generations of entries: lookups that hit the
+// older one are moved to the current one, and once the current generation is
+// full the older one is dropped whole. That bounds memory with LRU-like
+// behaviour and no per-entry bookkeeping.
+//
+// A font's tables are dropped when Fl::set_font() gives it a different name,
+// and TextMeasure_Clear() drops everything (e.g. after a scale change).
+//
+// With the ASCII fast path enabled, printable ASCII strings are measured by
+// summing per-glyph advances from a 95-entry table. That skips the driver
+// completely but ignores kerning, so it is off by default.
+
+#define TM_DEFAULT_ENTRIES 8192
+
+struct TextMeasureStats {
+	long long hits;
+	long long misses;
+	long long ascii_hits;
+	long long clears;
+	int entries;
+};
+
+struct MeasuredText {
+	std::string text;
+	double width;  // TextMeasure_Width()
+	int w, h;      // TextMeasure_Measure()
+};
+
+typedef std::unordered_map<uint64_t, MeasuredText> MeasureGeneration;
+
+struct FontMeasures {
+	const char* name = nullptr;  // Fl::get_font() when the tables were filled
+	double ascii[95];
+	bool has_ascii = false;
+	MeasureGeneration current;
+	MeasureGeneration previous;
+};
+
+static struct {
+	std::unordered_map<uint32_t, FontMeasures> fonts;
+	size_t max_entries = TM_DEFAULT_ENTRIES;
+	bool ascii_fast_path = false;
+	TextMeasureStats stats = {};
+} measure;
+
+// FNV-1a over the text, seeded with what else the result depends on.
+static uint64_t measure_hash(const char* s, int n, uint64_t seed) {
+	uint64_t h = 0xcbf29ce484222325ull ^ seed;
+
+	for (int i = 0; i < n; i++) {
+		h ^= (unsigned char)s[i];
+		h *= 0x100000001b3ull;
+	}
+
+	return h;
+}
+
+static FontMeasures& current_font() {
+	Fl_Font font = fl_font();
+	uint32_t key = ((uint32_t)font << 16) | (uint16_t)fl_size();
+	FontMeasures& f = measure.fonts[key];
+	const char* name = Fl::get_font(font);
+
+	if (f.name != name) {
+		if (f.name != nullptr)
+			measure.stats.clears++;
+
+		f.name = name;
+		f.has_ascii = false;
+		f.current.clear();
+		f.previous.clear();
+	}
+
+	return f;
+}
+
+static const MeasuredText* measure_find(FontMeasures& f, uint64_t h, const char* s, int n) {
+	auto found = f.current.find(h);
+
+	if (found != f.current.end())
+		return found->second.text.compare(0, std::string::npos, s, n) == 0 ? &found->second : nullptr;
+
+	found = f.previous.find(h);
+
+	if (found == f.previous.end() || found->second.text.compare(0, std::string::npos, s, n) != 0)
+		return nullptr;
+
+	MeasuredText& promoted = f.current[h];
+	promoted = std::move(found->second);
+	f.previous.erase(found);
+	return &promoted;
+}
+
+static MeasuredText& measure_store(FontMeasures& f, uint64_t h, const char* s, int n) {
+	if (f.current.size() >= measure.max_entries / 2) {
+		f.previous.swap(f.current);
+		f.current.clear();
+	}
+
+	MeasuredText& m = f.current[h];
+	m.text.assign(s, n);
+	return m;
+}
+
+static bool ascii_width(FontMeasures& f, const char* s, int n, double* width) {
+	double sum = 0;
+
+	for (int i = 0; i < n; i++) {
+		unsigned char c = (unsigned char)s[i];
+
+		if (c < 32 || c > 126)
+			return false;
+	}
+
+	if (!f.has_ascii) {
+		for (int c = 32; c <= 126; c++)
+			f.ascii[c - 32] = fl_width((unsigned int)c);
+		f.has_ascii = true;
+	}
+
+	for (int i = 0; i < n; i++)
+		sum += f.ascii[(unsigned char)s[i] - 32];
+
+	*width = sum;
+	return true;
+}
+
+// max_entries is per font and size (0 keeps the current value).
+extern "C" void TextMeasure_Configure(int max_entries, int ascii_fast_path) {
+	if (max_entries > 0)
+		measure.max_entries = max_entries < 2 ? 2 : (size_t)max_entries;
+
+	measure.ascii_fast_path = ascii_fast_path != 0;
+}
+
+// fl_width(s, n) in the current font.
+extern "C" double TextMeasure_Width(const char* s, int n) {
+	FontMeasures& f = current_font();
+	double width;
+
+	if (n <= 0)
+		return 0;
+
+	if (measure.ascii_fast_path && ascii_width(f, s, n, &width)) {
+		measure.stats.ascii_hits++;
+		return width;
+	}
+
+	uint64_t h = measure_hash(s, n, 0);
+	const MeasuredText* m = measure_find(f, h, s, n);
+
+	if (m != nullptr) {
+		measure.stats.hits++;
+		return m->width;
+	}
+
+	measure.stats.misses++;
+	width = fl_width(s, n);
+	measure_store(f, h, s, n).width = width;
+	return width;
+}
+
+// fl_measure(s, *w, *h, draw_symbols) in the current font; *w is the wrap width
+// on input, as with fl_measure().
+extern "C" void TextMeasure_Measure(const char* s, int* w, int* h, int draw_symbols) {
+	FontMeasures& f = current_font();
+	int n = s != nullptr ? (int)strlen(s) : 0;
+	uint64_t hash = measure_hash(s, n, ((uint64_t)(uint32_t)*w << 1 | (draw_symbols ? 1 : 0)) + 1);
+	const MeasuredText* m = measure_find(f, hash, s, n);
+
+	if (m != nullptr) {
+		measure.stats.hits++;
+		*w = m->w;
+		*h = m->h;
+		return;
+	}
+
+	measure.stats.misses++;
+	fl_measure(s, *w, *h, draw_symbols);
+
+	MeasuredText& stored = measure_store(f, hash, s, n);
+	stored.w = *w;
+	stored.h = *h;
+}
+
+extern "C" void TextMeasure_Clear() {
+	measure.fonts.clear();
+	measure.stats.clears++;
+}
+
+extern "C" void TextMeasure_Stats(TextMeasureStats* stats) {
+	*stats = measure.stats;
+	stats->entries = 0;
+
+	for (auto& f : measure.fonts)
+		stats->entries += (int)(f.second.current.size() + f.second.previous.size());
+}
@@ -0,0 +1,621 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/Fl_Text_Buffer.H>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TEXT_SEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+// Substring search over Fl_Text_Buffer without per-character decoding.
+//
+// Fl_Text_Buffer::search_forward() and friends compare one UTF-8 character at
+// a time through char_at(). Here the gap buffer is searched as (at most) two
+// raw slices plus the few bytes around the gap, so a match can still straddle
+// it. Candidates are found 16 or 32 bytes at a time by comparing the first and
+// the last byte of the pattern (SSE2 and AVX2 versions picked at runtime); only
+// those are compared in full. UTF-8 needs no decoding for this: a valid
+// pattern can only match at character boundaries. Case-insensitive search
+// folds ASCII letters only.
+//
+// Find-all can also run on a worker thread, over a snapshot of the buffer
+// taken when it starts, optionally with a regular expression (ECMAScript on
+// bytes, matched line by line). Matches are handed to the UI in batches through
+// awake_post() while the search continues. Changing the buffer stops the
+// search, since the positions would no longer be right. FLTK doesn't tell
+// anyone when a buffer is deleted: TextSearch_Detach() must be called first.
+
+#define TEXT_SEARCH_BLOCK (1 << 16)   // bytes per backward step / cancel check
+#define TEXT_SEARCH_BATCH 4096        // matches per delivery, at most
+#define TEXT_SEARCH_BATCH_MS 30
+
+// libstdc++'s default regex executor recurses once per subject byte, so a
+// long line (minified code, say) overflows the worker's stack. Its Thompson NFA
+// mode, an extension, doesn't; it only refuses back-references. Elsewhere long
+// lines are cut into spans short enough for the recursion. Either way a span is
+// a cancellation point, and matches can't cross span boundaries.
+#ifdef __GLIBCXX__
+#define TEXT_SEARCH_REGEX_MODE std::regex_constants::__polynomial
+#define TEXT_SEARCH_REGEX_SPAN ((size_t)1 << 20)
+#else
+#define TEXT_SEARCH_REGEX_MODE std::regex_constants::ECMAScript
+#define TEXT_SEARCH_REGEX_SPAN ((size_t)1 << 10)
+#endif
+
+enum TextSearchFlags {
+	TEXT_SEARCH_MATCH_CASE = 1,
+	TEXT_SEARCH_REGEX = 2,
+};
+
+typedef void (*TextSearchProc)(void* data, const int* ranges, int count, int status);
+
+static inline unsigned char fold_byte(unsigned char c) {
+	return (unsigned)(c - 'A') < 26 ? c | 0x20 : c;
+}
+
+static bool same(const char* s, const char* p, size_t m, bool fold) {
+	if (!fold)
+		return memcmp(s, p, m) == 0;
+
+	for (size_t i = 0; i < m; i++) {
+		if (fold_byte(s[i]) != fold_byte(p[i]))
+			return false;
+	}
+
+	return true;
+}
+
+// First match of p (m > 0 bytes) in h[0, n), or null.
+typedef const char* (*FindProc)(const char* h, size_t n, const char* p, size_t m, bool fold);
+
+static const char* find_scalar(const char* h, size_t n, const char* p, size_t m, bool fold) {
+	if (n < m)
+		return nullptr;
+
+	const char* last = h + n - m;
+
+	if (!fold) {
+		for (const char* s = h; s <= last; s++) {
+			s = (const char*)memchr(s, p[0], last - s + 1);
+
+			if (s == nullptr)
+				return nullptr;
+			if (memcmp(s + 1, p + 1, m - 1) == 0)
+				return s;
+		}
+
+		return nullptr;
+	}
+
+	unsigned char first = fold_byte(p[0]);
+
+	for (const char* s = h; s <= last; s++) {
+		if (fold_byte(*s) == first && same(s + 1, p + 1, m - 1, true))
+			return s;
+	}
+
+	return nullptr;
+}
+
+#ifdef TEXT_SEARCH_X86
+
+// The byte of the pattern and, when folding letters, its other case.
+static void case_pair(char c, bool fold, char* a, char* b) {
+	*a = *b = c;
+
+	if (fold && (unsigned)(fold_byte(c) - 'a') < 26) {
+		*a = (char)fold_byte(c);
+		*b = (char)(*a & ~0x20);
+	}
+}
+
+__attribute__((target("sse2")))
+static const char* find_sse2(const char* h, size_t n, const char* p, size_t m, bool fold) {
+	char f1, f2, l1, l2;
+
+	case_pair(p[0], fold, &f1, &f2);
+	case_pair(p[m - 1], fold, &l1, &l2);
+
+	const __m128i first1 = _mm_set1_epi8(f1), first2 = _mm_set1_epi8(f2);
+	const __m128i last1 = _mm_set1_epi8(l1), last2 = _mm_set1_epi8(l2);
+	size_t i = 0;
+
+	for (; i + m - 1 + 16 <= n; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(h + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(h + i + m - 1));
+		__m128i eq_a = _mm_or_si128(_mm_cmpeq_epi8(a, first1), _mm_cmpeq_epi8(a, first2));
+		__m128i eq_b = _mm_or_si128(_mm_cmpeq_epi8(b, last1), _mm_cmpeq_epi8(b, last2));
+		unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(eq_a, eq_b));
+
+		while (mask != 0) {
+			int bit = __builtin_ctz(mask);
+
+			if (same(h + i + bit + 1, p + 1, m > 2 ? m - 2 : 0, fold))
+				return h + i + bit;
+
+			mask &= mask - 1;
+		}
+	}
+
+	return find_scalar(h + i, n - i, p, m, fold);
+}
+
+__attribute__((target("avx2")))
+static const char* find_avx2(const char* h, size_t n, const char* p, size_t m, bool fold) {
+	char f1, f2, l1, l2;
+
+	case_pair(p[0], fold, &f1, &f2);
+	case_pair(p[m - 1], fold, &l1, &l2);
+
+	const __m256i first1 = _mm256_set1_epi8(f1), first2 = _mm256_set1_epi8(f2);
+	const __m256i last1 = _mm256_set1_epi8(l1), last2 = _mm256_set1_epi8(l2);
+	size_t i = 0;
+
+	for (; i + m - 1 + 32 <= n; i += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(h + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(h + i + m - 1));
+		__m256i eq_a = _mm256_or_si256(_mm256_cmpeq_epi8(a, first1), _mm256_cmpeq_epi8(a, first2));
+		__m256i eq_b = _mm256_or_si256(_mm256_cmpeq_epi8(b, last1), _mm256_cmpeq_epi8(b, last2));
+		unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(eq_a, eq_b));
+
+		while (mask != 0) {
+			int bit = __builtin_ctz(mask);
+
+			if (same(h + i + bit + 1, p + 1, m > 2 ? m - 2 : 0, fold))
+				return h + i + bit;
+
+			mask &= mask - 1;
+		}
+	}
+
+	return find_sse2(h + i, n - i, p, m, fold);
+}
+
+#endif
+
+static FindProc find_kernel = nullptr;
+
+static void select_kernel() {
+	if (find_kernel != nullptr)
+		return;
+
+	find_kernel = find_scalar;
+
+#ifdef TEXT_SEARCH_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("sse2"))
+		find_kernel = find_sse2;
+	if (__builtin_cpu_supports("avx2"))
+		find_kernel = find_avx2;
+#endif
+}
+
+// Calls found(pos) for every non-overlapping match of p in [start, end) of b,
+// in order, until it returns false.
+template<typename F>
+static void scan(Fl_Text_Buffer* b, int start, int end, const char* p, int m, bool fold, F found) {
+	const char* part[2];
+	int len[2];
+
+	select_kernel();
+	TextBuffer_Slices(b, start, end, &part[0], &len[0], &part[1], &len[1]);
+
+	// Matches may start in the first slice as long as they end in the second.
+	int next = 0;  // offset from start where the next match may begin
+
+	for (int i = 0, base = 0; i < 2; base += len[i], i++) {
+		const char* h = part[i] + (next - base);
+		const char* hend = part[i] + len[i];
+
+		while (h < hend) {
+			const char* s = find_kernel(h, hend - h, p, m, fold);
+
+			if (s == nullptr)
+				break;
+
+			next = base + (int)(s - part[i]) + m;
+
+			if (!found(start + base + (int)(s - part[i])))
+				return;
+
+			h = s + m;
+		}
+
+		if (i == 1 || len[1] == 0)
+			break;
+
+		// Around the gap: the last m - 1 bytes of the first slice and the first
+		// m - 1 of the second.
+		int before = len[0] - next < m - 1 ? len[0] - next : m - 1;
+		int after = len[1] < m - 1 ? len[1] : m - 1;
+		char around[2 * 256];
+
+		if (before > 0 && after > 0 && m <= 256) {
+			memcpy(around, part[0] + len[0] - before, before);
+			memcpy(around + before, part[1], after);
+
+			for (int k = 0; k < before; k++) {
+				if (k + m <= before + after && same(around + k, p, m, fold)) {
+					next = len[0] - before + k + m;
+
+					if (!found(start + len[0] - before + k))
+						return;
+
+					break;
+				}
+			}
+		}
+
+		if (next < len[0])
+			next = len[0];
+	}
+}
+
+// Slow path for patterns too long for the gap window.
+static bool long_pattern_at(Fl_Text_Buffer* b, int pos, const char* p, int m, bool fold) {
+	for (int i = 0; i < m; i++) {
+		char c = b->byte_at(pos + i);
+
+		if (fold ? fold_byte(c) != fold_byte(p[i]) : c != p[i])
+			return false;
+	}
+
+	return true;
+}
+
+static bool search_forward(Fl_Text_Buffer* b, int start, int end, const char* p, int m, bool fold, int* pos) {
+	bool hit = false;
+
+	scan(b, start, end, p, m, fold, [&](int at) {
+		*pos = at;
+		hit = true;
+		return false;
+	});
+
+	// A pattern longer than 256 bytes straddling the gap is checked by hand.
+	if (m > 256) {
+		int gap_match_end = hit ? *pos : end;
+		const char *first, *second;
+		int first_len, second_len;
+
+		TextBuffer_Slices(b, start, end, &first, &first_len, &second, &second_len);
+
+		for (int at = start + first_len - m + 1; second_len > 0 && at < start + first_len && at < gap_match_end; at++) {
+			if (at >= start && at + m <= end && long_pattern_at(b, at, p, m, fold)) {
+				*pos = at;
+				return true;
+			}
+		}
+	}
+
+	return hit;
+}
+
+// Last match that begins before start, searching back one block at a time.
+static bool search_backward(Fl_Text_Buffer* b, int start, const char* p, int m, bool fold, int* pos) {
+	int end = start + m - 1 < b->length() ? start + m - 1 : b->length();
+
+	while (end > 0) {
+		int from = end > TEXT_SEARCH_BLOCK ? end - TEXT_SEARCH_BLOCK : 0;
+		int last = -1;
+
+		// Every match inside the block, keeping the last one.
+		for (int at = from, found; at < end && search_forward(b, at, end, p, m, fold, &found); at = found + 1) {
+			if (found >= start)
+				break;
+			last = found;
+		}
+
+		if (last >= 0) {
+			*pos = last;
+			return true;
+		}
+
+		if (from == 0)
+			break;
+
+		end = from + m - 1;
+	}
+
+	return false;
+}
+
+static std::string last_error;
+
+// Like Fl_Text_Buffer::search_forward(): first match at or after start.
+extern "C" int TextSearch_Forward(Fl_Text_Buffer* b, int start, const char* pattern, int length, int match_case, int* found) {
+	if (length <= 0 || start < 0)
+		return 0;
+
+	return search_forward(b, start, b->length(), pattern, length, !match_case, found);
+}
+
+// Last match that begins before start.
+extern "C" int TextSearch_Backward(Fl_Text_Buffer* b, int start, const char* pattern, int length, int match_case, int* found) {
+	if (length <= 0 || start <= 0)
+		return 0;
+
+	return search_backward(b, start, pattern, length, !match_case, found);
+}
+
+// Writes up to max (start, end) pairs of matches in [start, end) to ranges and
+// returns how many it wrote.
+extern "C" int TextSearch_FindAll(Fl_Text_Buffer* b, int start, int end, const char* pattern, int length, int match_case,
+		int* ranges, int max) {
+	int count = 0;
+
+	if (length <= 0 || max <= 0)
+		return 0;
+
+	if (end < 0 || end > b->length())
+		end = b->length();
+
+	for (int at = start, found; at < end && search_forward(b, at, end, pattern, length, !match_case, &found); at = found + length) {
+		ranges[2 * count] = found;
+		ranges[2 * count + 1] = found + length;
+
+		if (++count == max)
+			break;
+	}
+
+	return count;
+}
+
+// A find-all running on a worker thread.
+struct TextSearch {
+	Fl_Text_Buffer* buffer;
+	TextSearchProc callback;  // null once cancelled
+	void* data;
+	bool attached;            // has the modify callback
+
+	std::string text;  // snapshot
+	std::string pattern;
+	bool fold;
+	bool regex;
+	std::regex re;
+
+	std::atomic<bool> cancel;
+
+	std::mutex lock;
+	std::vector<int> pending;
+
+	AwakePost wake;    // batches
+	AwakePost finish;  // posted once, last
+};
+
+// Searches with the modify callback attached, for TextSearch_Detach().
+static std::vector<TextSearch*> attached_searches;
+
+static void text_search_modified(int pos, int inserted, int deleted, int restyled, const char* deleted_text, void* arg);
+
+static void text_search_detach(TextSearch* s) {
+	if (!s->attached)
+		return;
+
+	s->buffer->remove_modify_callback(text_search_modified, s);
+	s->attached = false;
+	attached_searches.erase(std::find(attached_searches.begin(), attached_searches.end(), s));
+}
+
+// Hands over the matches found so far.
+static void text_search_deliver(void* arg) {
+	TextSearch* s = (TextSearch*)arg;
+	std::vector<int> ranges;
+
+	awake_drained(s->wake);
+
+	{
+		std::lock_guard<std::mutex> guard(s->lock);
+		ranges.swap(s->pending);
+	}
+
+	if (s->callback != nullptr && !ranges.empty())
+		s->callback(s->data, ranges.data(), (int)ranges.size() / 2, 1);
+}
+
+// The worker is done with s. Awake handlers run in the order they were
+// posted, so no delivery for s can come after this one.
+static void text_search_finish(void* arg) {
+	TextSearch* s = (TextSearch*)arg;
+
+	if (s->callback != nullptr)
+		s->callback(s->data, s->pending.data(), (int)s->pending.size() / 2, 0);
+
+	text_search_detach(s);
+	delete s;
+}
+
+static void text_search_post(TextSearch* s, std::vector<int>& batch, bool finished) {
+	{
+		std::lock_guard<std::mutex> guard(s->lock);
+
+		s->pending.insert(s->pending.end(), batch.begin(), batch.end());
+		batch.clear();
+	}
+
+	// s is freed once the finish handler has run.
+	awake_post(finished ? s->finish : s->wake);
+}
+
+static void text_search_worker(TextSearch* s) {
+	std::vector<int> batch;
+	auto posted = std::chrono::steady_clock::now();
+	const char* text = s->text.data();
+	size_t n = s->text.size();
+
+	auto found = [&](size_t start, size_t end) {
+		batch.push_back((int)start);
+		batch.push_back((int)end);
+
+		if (batch.size() >= 2 * TEXT_SEARCH_BATCH ||
+				std::chrono::steady_clock::now() - posted > std::chrono::milliseconds(TEXT_SEARCH_BATCH_MS)) {
+			text_search_post(s, batch, false);
+			posted = std::chrono::steady_clock::now();
+		}
+	};
+
+	if (s->regex) {
+		// Line by line, and long lines span by span.
+		for (size_t line = 0; line <= n && !s->cancel; ) {
+			const char* end = (const char*)memchr(text + line, '\n', n - line);
+			size_t line_end = end != nullptr ? end - text : n;
+
+			for (size_t at = line; !s->cancel; ) {
+				size_t span_end = line_end;
+				auto flags = std::regex_constants::match_default;
+
+				if (line_end - at > TEXT_SEARCH_REGEX_SPAN) {
+					span_end = at + TEXT_SEARCH_REGEX_SPAN;
+
+					// Not inside a UTF-8 sequence.
+					while (span_end > at + 1 && ((unsigned char)text[span_end] & 0xC0) == 0x80)
+						span_end--;
+
+					flags |= std::regex_constants::match_not_eol;
+				}
+
+				if (at > line)
+					flags |= std::regex_constants::match_prev_avail;
+
+				for (std::cregex_iterator it(text + at, text + span_end, s->re, flags), stop; it != stop && !s->cancel; ++it) {
+					if (it->length(0) > 0)
+						found(at + it->position(0), at + it->position(0) + it->length(0));
+				}
+
+				if (span_end == line_end)
+					break;
+
+				at = span_end;
+			}
+
+			line = line_end + 1;
+		}
+	} else {
+		const char* p = s->pattern.data();
+		size_t m = s->pattern.size();
+
+		for (size_t at = 0; at + m <= n && !s->cancel; ) {
+			size_t block_end = at + TEXT_SEARCH_BLOCK + m - 1 < n ? at + TEXT_SEARCH_BLOCK + m - 1 : n;
+			const char* hit = find_kernel(text + at, block_end - at, p, m, s->fold);
+
+			if (hit == nullptr) {
+				at = block_end - m + 1;
+				continue;
+			}
+
+			found(hit - text, hit - text + m);
+			at = hit - text + m;
+		}
+	}
+
+	text_search_post(s, batch, true);
+}
+
+// The matches would be off: stop, and tell the caller with status -1. The
+// modify callback itself is removed later, not while the buffer is calling it.
+static void text_search_modified(int, int inserted, int deleted, int, const char*, void* arg) {
+	TextSearch* s = (TextSearch*)arg;
+
+	if ((inserted == 0 && deleted == 0) || s->callback == nullptr)
+		return;
+
+	TextSearchProc callback = s->callback;
+
+	s->cancel = true;
+	s->callback = nullptr;
+	callback(s->data, nullptr, 0, -1);
+}
+
+// Starts a find-all over the whole buffer. callback gets batches of (start,
+// end) pairs with status 1, then a last call with status 0, or -1 if the buffer
+// changed. Returns null if the regular expression doesn't compile
+// (TextSearch_Error() says why).
+extern "C" TextSearch* TextSearch_Start(Fl_Text_Buffer* b, const char* pattern, int length, int flags,
+		TextSearchProc callback, void* data) {
+	TextSearch* s = new TextSearch();
+	const char *first, *second;
+	int first_len, second_len;
+
+	s->buffer = b;
+	s->callback = callback;
+	s->data = data;
+	s->pattern.assign(pattern, length > 0 ? length : 0);
+	s->fold = !(flags & TEXT_SEARCH_MATCH_CASE);
+	s->regex = (flags & TEXT_SEARCH_REGEX) != 0;
+	s->cancel = false;
+	s->wake.handler = text_search_deliver;
+	s->wake.data = s;
+	s->finish.handler = text_search_finish;
+	s->finish.data = s;
+
+	if (s->regex) {
+		try {
+			auto options = std::regex::ECMAScript | std::regex::optimize | TEXT_SEARCH_REGEX_MODE;
+			s->re.assign(s->pattern, s->fold ? options | std::regex::icase : options);
+		} catch (const std::regex_error& e) {
+			last_error = e.what();
+			delete s;
+			return nullptr;
+		}
+	} else if (s->pattern.empty()) {
+		last_error = "empty pattern";
+		delete s;
+		return nullptr;
+	}
+
+	select_kernel();
+	TextBuffer_Slices(b, 0, b->length(), &first, &first_len, &second, &second_len);
+	s->text.reserve(first_len + second_len);
+	s->text.assign(first, first_len);
+	s->text.append(second, second_len);
+
+	b->add_modify_callback(text_search_modified, s);
+	s->attached = true;
+	attached_searches.push_back(s);
+	std::thread(text_search_worker, s).detach();
+	return s;
+}
+
+// Stops a running search; its callback isn't called again. Only valid until
+// the callback got status 0 or -1.
+extern "C" void TextSearch_Cancel(TextSearch* s) {
+	if (s->callback == nullptr)
+		return;
+
+	s->cancel = true;
+	s->callback = nullptr;
+	text_search_detach(s);
+}
+
+// Stops every search on b (their callbacks get status -1) and lets go of b.
+// Must be called before b is deleted while a search may be running.
+extern "C" void TextSearch_Detach(Fl_Text_Buffer* b) {
+	for (size_t i = attached_searches.size(); i-- > 0;) {
+		TextSearch* s = attached_searches[i];
+
+		if (s->buffer != b)
+			continue;
+
+		TextSearchProc callback = s->callback;
+
+		s->cancel = true;
+		s->callback = nullptr;
+		text_search_detach(s);
+
+		if (callback != nullptr)
+			callback(s->data, nullptr, 0, -1);
+	}
+}
+
+extern "C" const char* TextSearch_Error() {
+	return last_error.c_str();
+}
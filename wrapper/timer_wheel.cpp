@@ -0,0 +1,405 @@
+#include "fltk_d_wrapper.h"
+#include <chrono>
+#include <vector>
+#include <stdint.h>
+
+// Hierarchical timer wheel multiplexing any number of timers onto a single
+// Fl::add_timeout().
+//
+// FLTK keeps its timeouts in a sorted linked list: adding one walks the list
+// and Fl::remove_timeout() scans it, and every timer is a separate callback
+// into D. Here time is cut into ticks and timers hang in doubly linked slot
+// lists: WHEEL_LEVELS levels of 64 slots, level L slot s holding the timers
+// due in 64^L-tick steps. Adding and cancelling are O(1). Each level has a
+// 64-bit occupancy mask, so the wheel skips empty slots a word at a time and
+// knows when it has to wake up next; only that one FLTK timeout is pending.
+//
+// Everything that expired by the time the timeout runs is handed to D in one
+// call. Timers added with an alignment are rounded up to a multiple of it, so
+// periodic refreshes started at different times land on the same ticks and
+// are delivered together.
+//
+// Main thread only.
+
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN (1ll << (WHEEL_BITS * WHEEL_LEVELS))  // ticks the wheel can hold
+
+// Must match struct FiredTimer in source/fltk_d_timer.d
+struct FiredTimer {
+	long long handle;
+	void* data;
+	int missed;  // periods skipped because the loop was late
+	int done;    // 1 if the timer won't fire again (the handle is now invalid)
+};
+
+struct TimerWheelStats {
+	long long added;
+	long long cancelled;
+	long long fired;
+	long long batches;
+	long long cascaded;  // timers moved down a level
+	long long missed;
+	int pending;
+};
+
+typedef void (*TimerDispatchProc)(void* data, const FiredTimer* fired, size_t count);
+
+struct TimerNode {
+	long long due;     // tick
+	long long period;  // ticks, 0 for a one-shot
+	long long align;   // ticks, 0 if not aligned
+	void* data;
+	unsigned gen;      // bumped when the node is freed, so stale handles miss
+	int prev, next;    // slot list, or next free node
+	int slot;          // level * WHEEL_SLOTS + slot, -1 if not in the wheel
+};
+
+struct TimerWheel {
+	double tick;
+	std::chrono::steady_clock::time_point start;
+	long long now;        // last tick processed
+	long long target;     // tick being caught up to
+	long long scheduled;  // tick the FLTK timeout is set for, -1 if none
+
+	std::vector<TimerNode> nodes;
+	int free_head;
+	int heads[WHEEL_LEVELS * WHEEL_SLOTS];
+	uint64_t occupied[WHEEL_LEVELS];
+
+	std::vector<FiredTimer> batch;
+	TimerDispatchProc dispatch;
+	void* data;
+	bool dispatching;
+	bool destroyed;  // by the dispatch; freed once it returns
+
+	TimerWheelStats stats;
+};
+
+static void timer_wheel_cb(void* data);
+
+static long long timer_clock(TimerWheel* w) {
+	std::chrono::duration<double> t = std::chrono::steady_clock::now() - w->start;
+	return (long long)(t.count() / w->tick + 1e-6);
+}
+
+// Files node i in the slot for its due tick, or earliest if that is sooner.
+static void timer_link(TimerWheel* w, int i, long long earliest) {
+	TimerNode& n = w->nodes[i];
+	long long expires = n.due > earliest ? n.due : earliest;
+	long long delta = expires - w->now;
+	int level = 0;
+
+	// Beyond the top level: park in the farthest slot and re-file from there.
+	if (delta >= WHEEL_SPAN)
+		expires = w->now + WHEEL_SPAN - 1;
+
+	while (level < WHEEL_LEVELS - 1 && delta >= (1ll << (WHEEL_BITS * (level + 1))))
+		level++;
+
+	int s = (int)((expires >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1));
+	int slot = level * WHEEL_SLOTS + s;
+
+	n.slot = slot;
+	n.prev = -1;
+	n.next = w->heads[slot];
+
+	if (n.next >= 0)
+		w->nodes[n.next].prev = i;
+
+	w->heads[slot] = i;
+	w->occupied[level] |= (uint64_t)1 << s;
+}
+
+static void timer_unlink(TimerWheel* w, int i) {
+	TimerNode& n = w->nodes[i];
+
+	if (n.prev >= 0)
+		w->nodes[n.prev].next = n.next;
+	else
+		w->heads[n.slot] = n.next;
+
+	if (n.next >= 0)
+		w->nodes[n.next].prev = n.prev;
+
+	if (w->heads[n.slot] < 0)
+		w->occupied[n.slot / WHEEL_SLOTS] &= ~((uint64_t)1 << (n.slot % WHEEL_SLOTS));
+
+	n.slot = -1;
+}
+
+static void timer_free(TimerWheel* w, int i) {
+	TimerNode& n = w->nodes[i];
+
+	n.gen++;
+	n.data = nullptr;
+	n.next = w->free_head;
+	w->free_head = i;
+	w->stats.pending--;
+}
+
+static long long timer_handle(TimerWheel* w, int i) {
+	return ((long long)w->nodes[i].gen << 32) | (unsigned)(i + 1);
+}
+
+// Node of a live handle, -1 if it fired or was cancelled.
+static int timer_find(TimerWheel* w, long long handle) {
+	int i = (int)(handle & 0xffffffff) - 1;
+
+	if (i < 0 || i >= (int)w->nodes.size())
+		return -1;
+
+	TimerNode& n = w->nodes[i];
+	return n.gen == (unsigned)(handle >> 32) && n.slot >= 0 ? i : -1;
+}
+
+static long long timer_align(long long due, long long align) {
+	return align > 0 ? (due + align - 1) / align * align : due;
+}
+
+// Re-files the timers of the current slot of level; they are all due within
+// the span of the level below (or right now, at the tick being processed).
+static void timer_cascade(TimerWheel* w, int level) {
+	int s = (int)((w->now >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1));
+	int slot = level * WHEEL_SLOTS + s;
+	int i = w->heads[slot];
+
+	w->heads[slot] = -1;
+	w->occupied[level] &= ~((uint64_t)1 << s);
+
+	while (i >= 0) {
+		int next = w->nodes[i].next;
+
+		timer_link(w, i, w->now);
+		w->stats.cascaded++;
+		i = next;
+	}
+}
+
+// Moves the timers of the current level 0 slot to the batch.
+static void timer_expire(TimerWheel* w) {
+	int s = (int)(w->now & (WHEEL_SLOTS - 1));
+	int i = w->heads[s];
+
+	w->heads[s] = -1;
+	w->occupied[0] &= ~((uint64_t)1 << s);
+
+	while (i >= 0) {
+		TimerNode& n = w->nodes[i];
+		int next = n.next;
+
+		n.slot = -1;
+
+		// Parked at the end of the wheel, not actually due yet.
+		if (n.due > w->now) {
+			timer_link(w, i, w->now + 1);
+			i = next;
+			continue;
+		}
+
+		FiredTimer f = { timer_handle(w, i), n.data, 0, n.period == 0 };
+
+		// Periods that passed while the loop was late are skipped, not replayed.
+		if (n.period > 0) {
+			n.due += n.period;
+
+			if (n.due <= w->target) {
+				f.missed = (int)((w->target - n.due) / n.period + 1);
+				n.due += f.missed * n.period;
+				w->stats.missed += f.missed;
+			}
+
+			n.due = timer_align(n.due, n.align);
+			timer_link(w, i, w->now + 1);
+		} else {
+			timer_free(w, i);
+		}
+
+		w->batch.push_back(f);
+		i = next;
+	}
+}
+
+// Earliest tick anything can happen at: the next occupied level 0 slot of this
+// turn, or the wrap (where the upper levels cascade).
+static long long timer_next_tick(TimerWheel* w) {
+	int s = (int)(w->now & (WHEEL_SLOTS - 1));
+	uint64_t ahead = s < WHEEL_SLOTS - 1 ? w->occupied[0] & (~(uint64_t)0 << (s + 1)) : 0;
+
+	if (ahead != 0)
+		return (w->now & ~(long long)(WHEEL_SLOTS - 1)) + __builtin_ctzll(ahead);
+
+	return (w->now | (WHEEL_SLOTS - 1)) + 1;
+}
+
+// Processes every tick up to target, jumping over empty level 0 slots.
+static void timer_advance(TimerWheel* w, long long target) {
+	w->target = target;
+
+	while (w->now < target) {
+		long long next = timer_next_tick(w);
+
+		if (next > target) {
+			w->now = target;
+			break;
+		}
+
+		w->now = next;
+
+		// Level 0 wrapped: bring down the next slot of each level that wrapped.
+		if ((w->now & (WHEEL_SLOTS - 1)) == 0) {
+			for (int level = 1; level < WHEEL_LEVELS; level++) {
+				timer_cascade(w, level);
+
+				if ((w->now >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1))
+					break;
+			}
+		}
+
+		timer_expire(w);
+	}
+}
+
+// -1 if the wheel is empty.
+static long long timer_next(TimerWheel* w) {
+	return w->stats.pending > 0 ? timer_next_tick(w) : -1;
+}
+
+// Keeps the one FLTK timeout at the next tick anything is due.
+static void timer_schedule(TimerWheel* w) {
+	long long next = timer_next(w);
+
+	if (next == w->scheduled)
+		return;
+
+	if (w->scheduled >= 0)
+		Fl::remove_timeout(timer_wheel_cb, w);
+
+	w->scheduled = next;
+
+	if (next < 0)
+		return;
+
+	std::chrono::duration<double> t = std::chrono::steady_clock::now() - w->start;
+	double delay = next * w->tick - t.count();
+
+	Fl::add_timeout(delay > 0 ? delay : 0, timer_wheel_cb, w);
+}
+
+static void timer_wheel_cb(void* data) {
+	TimerWheel* w = (TimerWheel*)data;
+
+	w->scheduled = -1;
+	w->batch.clear();
+	timer_advance(w, timer_clock(w));
+
+	if (!w->batch.empty()) {
+		w->stats.fired += w->batch.size();
+		w->stats.batches++;
+
+		// D may add and cancel timers from here; the batch is already taken.
+		w->dispatching = true;
+		w->dispatch(w->data, w->batch.data(), w->batch.size());
+		w->dispatching = false;
+
+		if (w->destroyed) {
+			delete w;
+			return;
+		}
+	}
+
+	timer_schedule(w);
+}
+
+// tick is the resolution in seconds (1/60 fires on frame boundaries).
+extern "C" TimerWheel* TimerWheel_Create(double tick, TimerDispatchProc dispatch, void* data) {
+	TimerWheel* w = new TimerWheel();
+
+	w->tick = tick > 0 ? tick : 1.0 / 60;
+	w->start = std::chrono::steady_clock::now();
+	w->now = 0;
+	w->target = 0;
+	w->scheduled = -1;
+	w->free_head = -1;
+
+	for (int& head : w->heads)
+		head = -1;
+	for (uint64_t& bits : w->occupied)
+		bits = 0;
+
+	w->dispatch = dispatch;
+	w->data = data;
+	w->dispatching = false;
+	w->destroyed = false;
+	w->stats = {};
+	return w;
+}
+
+// Also from inside the dispatch; the rest of that batch is still delivered,
+// but w must not be used again.
+extern "C" void TimerWheel_Destroy(TimerWheel* w) {
+	Fl::remove_timeout(timer_wheel_cb, w);
+
+	if (w->dispatching) {
+		w->destroyed = true;
+		return;
+	}
+
+	delete w;
+}
+
+// Fires after delay seconds, then every period seconds if period > 0. With
+// align > 0 every due time is rounded up to a multiple of align seconds.
+// Returns the handle for TimerWheel_Cancel.
+extern "C" long long TimerWheel_Add(TimerWheel* w, double delay, double period, double align, void* data) {
+	int i = w->free_head;
+
+	if (i >= 0) {
+		w->free_head = w->nodes[i].next;
+	} else {
+		i = (int)w->nodes.size();
+		w->nodes.push_back(TimerNode{ 0, 0, 0, nullptr, 1, -1, -1, -1 });
+	}
+
+	// Ticks pass without the wheel looking while it is idle.
+	if (w->stats.pending == 0)
+		w->now = timer_clock(w);
+
+	TimerNode& n = w->nodes[i];
+	long long ticks = (long long)(delay / w->tick + 0.5);
+
+	n.period = period > 0 ? (long long)(period / w->tick + 0.5) : 0;
+	n.align = align > 0 ? (long long)(align / w->tick + 0.5) : 0;
+	n.due = timer_align(timer_clock(w) + (ticks > 0 ? ticks : 1), n.align);
+	n.data = data;
+
+	if (period > 0 && n.period == 0)
+		n.period = 1;
+
+	timer_link(w, i, w->now + 1);
+	w->stats.added++;
+	w->stats.pending++;
+
+	timer_schedule(w);
+	return timer_handle(w, i);
+}
+
+// Returns 1 if the timer was still pending.
+extern "C" int TimerWheel_Cancel(TimerWheel* w, long long handle) {
+	int i = timer_find(w, handle);
+
+	if (i < 0)
+		return 0;
+
+	timer_unlink(w, i);
+	timer_free(w, i);
+	w->stats.cancelled++;
+
+	timer_schedule(w);
+	return 1;
+}
+
+extern "C" void TimerWheel_Stats(TimerWheel* w, TimerWheelStats* stats) {
+	*stats = w->stats;
+}
@@ -0,0 +1,193 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/Fl_Tree.H>
+#include <Fl/Fl_Tree_Item.H>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Bulk construction of Fl_Tree hierarchies, and lazily populated subtrees.
+//
+// Fl_Tree::add(path) splits the path and searches each level's children
+// linearly, so loading n items costs O(n * siblings). The builders below
+// create every item with one Fl_Tree_Item::add() on an already known parent:
+// from a parent-index table directly, and from a path list by reusing the
+// previous path's ancestors and an index of (parent, label) for everything
+// else. Sorting is switched off while building, so children keep input order.
+//
+// FLTK offers no way to pre-size a child array (Fl_Tree_Item_Array::enlarge()
+// is private); its chunked growth is left as is.
+//
+// A lazy item gets a single placeholder child, so it shows an open icon but
+// costs nothing else. The placeholder is only ever laid out once its parent is
+// open; at that point it schedules the D populate hook, which runs outside of
+// draw(), after the placeholder has been removed.
+
+typedef void (*TreePopulateProc)(void* data, Fl_Tree* tree, Fl_Tree_Item* item);
+
+class Lazy_Tree_Item : public Fl_Tree_Item {
+public:
+	Lazy_Tree_Item(Fl_Tree* tree, TreePopulateProc populate, void* data):
+		Fl_Tree_Item(tree), _populate(populate), _data(data) {
+	}
+
+	~Lazy_Tree_Item() {
+		Fl::remove_timeout(populate_cb, this);
+	}
+
+	int draw_item_content(int render) override {
+		if (!_scheduled) {
+			_scheduled = true;
+			Fl::add_timeout(0.0, populate_cb, this);
+		}
+
+		return Fl_Tree_Item::draw_item_content(render);
+	}
+
+private:
+	static void populate_cb(void* data) {
+		Lazy_Tree_Item* placeholder = (Lazy_Tree_Item*)data;
+		Fl_Tree* tree = placeholder->tree();
+		Fl_Tree_Item* item = placeholder->parent();
+		TreePopulateProc populate = placeholder->_populate;
+		void* populate_data = placeholder->_data;
+
+		tree->remove(placeholder);
+		populate(populate_data, tree, item);
+		tree->redraw();
+	}
+
+	TreePopulateProc _populate;
+	void* _data;
+	bool _scheduled = false;
+};
+
+struct TreeChildKey {
+	Fl_Tree_Item* parent;
+	std::string label;
+
+	bool operator==(const TreeChildKey& o) const {
+		return parent == o.parent && label == o.label;
+	}
+};
+
+struct TreeChildKeyHash {
+	size_t operator()(const TreeChildKey& k) const {
+		return std::hash<std::string>()(k.label) ^ (std::hash<void*>()(k.parent) << 1);
+	}
+};
+
+static Fl_Tree_Item* add_child(Fl_Tree_Item* parent, const std::string& label) {
+	return parent->add(parent->prefs(), label.c_str());
+}
+
+// Builds count items; parents[i] is the index of item i's parent, which must be
+// lower than i, or -1 for a child of under (the root if null). Writes the new
+// items to out if it isn't null.
+extern "C" void TreeBuild_FromParents(Fl_Tree* tree, Fl_Tree_Item* under,
+		const DSlice* labels, const int* parents, int count, Fl_Tree_Item** out) {
+	std::vector<Fl_Tree_Item*> items(count);
+	std::string label;
+	Fl_Tree_Sort order = tree->sortorder();
+
+	if (under == nullptr)
+		under = tree->root();
+
+	tree->sortorder(FL_TREE_SORT_NONE);
+
+	for (int i = 0; i < count; i++) {
+		int p = parents[i];
+		Fl_Tree_Item* parent = p >= 0 && p < i ? items[p] : under;
+
+		label.assign(labels[i].ptr, labels[i].length);
+		items[i] = add_child(parent, label);
+
+		if (out != nullptr)
+			out[i] = items[i];
+	}
+
+	tree->sortorder(order);
+	tree->redraw();
+}
+
+// Builds the items for a list of paths (components split by separator).
+// Sorted input is fastest, since consecutive paths then share their ancestors,
+// but any order gives the same tree. Writes each path's leaf item to out if it
+// isn't null.
+extern "C" void TreeBuild_FromPaths(Fl_Tree* tree, Fl_Tree_Item* under,
+		const DSlice* paths, int count, char separator, Fl_Tree_Item** out) {
+	std::unordered_map<TreeChildKey, Fl_Tree_Item*, TreeChildKeyHash> index;
+	std::unordered_set<Fl_Tree_Item*> indexed;
+	std::vector<std::string> prev;   // components of the previous path
+	std::vector<Fl_Tree_Item*> stack;  // items for prev
+	std::vector<std::string> parts;
+	Fl_Tree_Sort order = tree->sortorder();
+
+	if (under == nullptr)
+		under = tree->root();
+
+	tree->sortorder(FL_TREE_SORT_NONE);
+
+	for (int i = 0; i < count; i++) {
+		const char* p = paths[i].ptr;
+		const char* e = p + paths[i].length;
+
+		parts.clear();
+
+		while (p < e) {
+			const char* s = p;
+			while (p < e && *p != separator)
+				p++;
+			if (p > s)
+				parts.emplace_back(s, p - s);
+			p++;
+		}
+
+		size_t depth = 0;
+
+		while (depth < parts.size() && depth < prev.size() && parts[depth] == prev[depth])
+			depth++;
+
+		stack.resize(depth);
+
+		for (size_t d = depth; d < parts.size(); d++) {
+			Fl_Tree_Item* parent = d == 0 ? under : stack[d - 1];
+
+			// Children that existed before this build are indexed on first use.
+			if (indexed.insert(parent).second) {
+				for (int c = 0; c < parent->children(); c++)
+					index.emplace(TreeChildKey{ parent, parent->child(c)->label() ? parent->child(c)->label() : "" }, parent->child(c));
+			}
+
+			TreeChildKey key{ parent, parts[d] };
+			auto found = index.find(key);
+			Fl_Tree_Item* item;
+
+			if (found != index.end()) {
+				item = found->second;
+			} else {
+				item = add_child(parent, parts[d]);
+				index.emplace(std::move(key), item);
+			}
+
+			stack.push_back(item);
+		}
+
+		prev.swap(parts);
+
+		if (out != nullptr)
+			out[i] = stack.empty() ? under : stack.back();
+	}
+
+	tree->sortorder(order);
+	tree->redraw();
+}
+
+// Gives item a placeholder child; populate is called with the item the first
+// time it is shown open, and should add its real children.
+extern "C" void TreeBuild_SetLazy(Fl_Tree* tree, Fl_Tree_Item* item, TreePopulateProc populate, void* data) {
+	Lazy_Tree_Item* placeholder = new Lazy_Tree_Item(tree, populate, data);
+
+	item->add(item->prefs(), "...", placeholder);
+	item->close();
+}
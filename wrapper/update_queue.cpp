@@ -0,0 +1,229 @@
+#include "fltk_d_wrapper.h"
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+
+// Lock-free multi-producer queue for posting UI updates from worker threads.
+//
+// Producers claim a cell of a bounded ring with a single CAS (Vyukov's bounded
+// queue) and never block or allocate; when the ring is full the update is
+// dropped and counted. Only the first post after a drain calls Fl::awake(), so
+// a burst of posts costs one wake-up instead of going through FLTK's mutexed
+// awake ring per message.
+//
+// On the main thread an Fl::add_check() handler drains everything queued so far
+// into one batch, merges coalescable updates aimed at the same (target, key)
+// (the newest value wins, the oldest position is kept) and hands the batch to
+// D in a single call.
+//
+// As with Fl::awake(), the main thread must have called Fl::lock() once before
+// entering the event loop.
+
+#define UPDATE_COALESCE 1
+
+// Must match struct QueuedUpdate in source/fltk_d_queue.d
+struct QueuedUpdate {
+	void* target;
+	int key;
+	int flags;
+	double value;
+	void* data;
+};
+
+struct UpdateQueueStats {
+	long long posted;
+	long long dropped;
+	long long delivered;
+	long long coalesced;
+	long long batches;
+	int depth;
+	int capacity;
+};
+
+typedef void (*UpdateDispatchProc)(void* data, const QueuedUpdate* updates, size_t count);
+
+struct UpdateCell {
+	std::atomic<size_t> seq;
+	QueuedUpdate update;
+};
+
+struct UpdateQueue {
+	UpdateCell* cells;
+	size_t mask;
+
+	alignas(64) std::atomic<size_t> enqueue_pos;
+	alignas(64) size_t dequeue_pos;
+	std::atomic<bool> wake_pending;
+
+	std::atomic<long long> posted;
+	std::atomic<long long> dropped;
+	long long delivered;
+	long long coalesced;
+	long long batches;
+
+	// Main thread only: the batch being delivered and the (target, key) index
+	// used to coalesce it. Index slots are valid when their stamp matches.
+	std::vector<QueuedUpdate> batch;
+	std::vector<int> index_slot;
+	std::vector<unsigned> index_stamp;
+	unsigned stamp;
+
+	UpdateDispatchProc dispatch;
+	void* data;
+};
+
+static size_t update_hash(const QueuedUpdate& u) {
+	uintptr_t h = (uintptr_t)u.target ^ ((uintptr_t)(unsigned)u.key * 0x9E3779B97F4A7C15ull);
+	return (size_t)(h ^ (h >> 29));
+}
+
+static bool update_pop(UpdateQueue* q, QueuedUpdate* out) {
+	UpdateCell* cell = &q->cells[q->dequeue_pos & q->mask];
+
+	if (cell->seq.load(std::memory_order_acquire) != q->dequeue_pos + 1)
+		return false;
+
+	*out = cell->update;
+	cell->seq.store(q->dequeue_pos + q->mask + 1, std::memory_order_release);
+	q->dequeue_pos++;
+	return true;
+}
+
+static void update_queue_drain(void* data) {
+	UpdateQueue* q = (UpdateQueue*)data;
+	size_t index_mask = q->index_slot.size() - 1;
+	QueuedUpdate u;
+
+	// Cleared first, so anything posted while we drain wakes the loop again.
+	q->wake_pending.store(false, std::memory_order_release);
+
+	q->batch.clear();
+	q->stamp++;
+
+	// Bounded by the capacity so a flood can't starve event handling.
+	while (q->batch.size() <= q->mask && update_pop(q, &u)) {
+		if (!(u.flags & UPDATE_COALESCE)) {
+			q->batch.push_back(u);
+			continue;
+		}
+
+		size_t i = update_hash(u) & index_mask;
+
+		while (q->index_stamp[i] == q->stamp) {
+			QueuedUpdate& prev = q->batch[q->index_slot[i]];
+			if (prev.target == u.target && prev.key == u.key)
+				break;
+			i = (i + 1) & index_mask;
+		}
+
+		if (q->index_stamp[i] == q->stamp) {
+			q->batch[q->index_slot[i]] = u;
+			q->coalesced++;
+		} else {
+			q->index_stamp[i] = q->stamp;
+			q->index_slot[i] = (int)q->batch.size();
+			q->batch.push_back(u);
+		}
+	}
+
+	if (q->batch.empty())
+		return;
+
+	q->delivered += q->batch.size();
+	q->batches++;
+	q->dispatch(q->data, q->batch.data(), q->batch.size());
+
+	// Left over from a flood: make sure the loop comes around again.
+	if (q->cells[q->dequeue_pos & q->mask].seq.load(std::memory_order_acquire) == q->dequeue_pos + 1
+			&& !q->wake_pending.exchange(true))
+		Fl::awake();
+}
+
+// Creates a queue holding up to capacity (rounded up to a power of two)
+// undelivered updates. Must be called on the main thread.
+extern "C" UpdateQueue* UpdateQueue_Create(int capacity, UpdateDispatchProc dispatch, void* data) {
+	size_t size = 2;
+
+	while (size < (size_t)capacity)
+		size *= 2;
+
+	UpdateQueue* q = new UpdateQueue();
+
+	q->cells = new UpdateCell[size];
+	q->mask = size - 1;
+
+	for (size_t i = 0; i < size; i++)
+		q->cells[i].seq.store(i, std::memory_order_relaxed);
+
+	q->enqueue_pos.store(0, std::memory_order_relaxed);
+	q->dequeue_pos = 0;
+	q->wake_pending.store(false);
+	q->posted.store(0);
+	q->dropped.store(0);
+	q->delivered = 0;
+	q->coalesced = 0;
+	q->batches = 0;
+
+	q->batch.reserve(size);
+	q->index_slot.resize(size * 2);
+	q->index_stamp.assign(size * 2, 0);
+	q->stamp = 0;
+
+	q->dispatch = dispatch;
+	q->data = data;
+
+	Fl::add_check(update_queue_drain, q);
+	return q;
+}
+
+// Main thread only; no producer may still be posting.
+extern "C" void UpdateQueue_Destroy(UpdateQueue* q) {
+	Fl::remove_check(update_queue_drain, q);
+	delete[] q->cells;
+	delete q;
+}
+
+// Safe from any thread. Returns 0 if the queue was full and the update dropped.
+extern "C" int UpdateQueue_Post(UpdateQueue* q, const QueuedUpdate* u) {
+	size_t pos = q->enqueue_pos.load(std::memory_order_relaxed);
+	UpdateCell* cell;
+
+	for (;;) {
+		cell = &q->cells[pos & q->mask];
+
+		size_t seq = cell->seq.load(std::memory_order_acquire);
+		intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+
+		if (dif == 0) {
+			if (q->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		} else if (dif < 0) {
+			q->dropped.fetch_add(1, std::memory_order_relaxed);
+			return 0;
+		} else {
+			pos = q->enqueue_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->update = *u;
+	cell->seq.store(pos + 1, std::memory_order_release);
+	q->posted.fetch_add(1, std::memory_order_relaxed);
+
+	if (!q->wake_pending.exchange(true, std::memory_order_acq_rel))
+		Fl::awake();
+
+	return 1;
+}
+
+// Safe from any thread; depth is approximate while producers are running.
+extern "C" void UpdateQueue_Stats(UpdateQueue* q, UpdateQueueStats* stats) {
+	size_t enqueued = q->enqueue_pos.load(std::memory_order_relaxed);
+
+	stats->posted = q->posted.load(std::memory_order_relaxed);
+	stats->dropped = q->dropped.load(std::memory_order_relaxed);
+	stats->delivered = q->delivered;
+	stats->coalesced = q->coalesced;
+	stats->batches = q->batches;
+	stats->depth = (int)(enqueued - q->dequeue_pos);
+	stats->capacity = (int)(q->mask + 1);
+}
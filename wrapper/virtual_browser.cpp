@@ -0,0 +1,517 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/Fl_Browser_.H>
+#include <Fl/fl_draw.H>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Text browser for very long lists, built on Fl_Browser_ like Fl_Browser.
+//
+// Fl_Browser mallocs one FL_BLINE per line and keeps them in a doubly linked
+// list, so find_line(n) walks from its cached line and full_height() walks
+// them all. Virtual_Browser has no per-line objects: an item is just its line
+// number cast to void*, so item_at(), item_next() and lineno() are O(1).
+// Lines live either in one arena (bulk loaded, NUL-terminated, with an offset
+// index) or are pulled from a D data source a block at a time into a small
+// direct-mapped cache.
+//
+// Line heights are kept in a HeightIndex, so full_height() is O(log n), and
+// scroll_to()/topline() seed Fl_Browser_'s scroll cursor with the line that
+// covers the new position: jumping anywhere doesn't step through the lines in
+// between. Lines are plain text: no '@' format characters and no columns.
+
+#define VB_BLOCK_LINES 128
+#define VB_CACHE_BLOCKS 32
+
+// Fills *text with lines first .. first + count - 1 concatenated (without
+// newlines) and *offsets with count+1 byte offsets into it. Both stay owned by
+// D and only have to remain valid until the call returns. Returns 0 on failure.
+typedef int (*VirtualBrowserFetchProc)(void* data, int first, int count,
+		const char** text, const int** offsets);
+
+struct VirtualBrowserStats {
+	long long hits;
+	long long fetches;
+	long long arena_bytes;
+	int lines;
+};
+
+struct LineBlock {
+	int block;  // -1 if empty
+	std::string text;
+	std::vector<int> offsets;
+};
+
+// Fl_Browser_ keeps its scroll cursor private; explicit instantiation is
+// allowed to name private members, which lets seed() reach it.
+template <typename Tag, typename Tag::type Member>
+struct BrowserPrivate {
+	friend typename Tag::type browser_member(Tag) { return Member; }
+};
+
+struct BrowserTop {
+	typedef void* Fl_Browser_::*type;
+	friend type browser_member(BrowserTop);
+};
+
+struct BrowserOffset {
+	typedef int Fl_Browser_::*type;
+	friend type browser_member(BrowserOffset);
+};
+
+struct BrowserRealPosition {
+	typedef int Fl_Browser_::*type;
+	friend type browser_member(BrowserRealPosition);
+};
+
+template struct BrowserPrivate<BrowserTop, &Fl_Browser_::top_>;
+template struct BrowserPrivate<BrowserOffset, &Fl_Browser_::offset_>;
+template struct BrowserPrivate<BrowserRealPosition, &Fl_Browser_::real_position_>;
+
+class Virtual_Browser : public Fl_Browser_ {
+public:
+	Virtual_Browser(int x, int y, int w, int h, const char* label = 0);
+	~Virtual_Browser();
+
+	void clear();
+	void load(const char* text, size_t len);
+	void add(const DSlice* lines, size_t count);
+	void source(VirtualBrowserFetchProc fetch, void* data, int lines);
+	void lines(int n);
+	void invalidate(int first, int last);
+	void heights(int first, const int* heights, int n);
+
+	int size() const { return _heights.count(); }
+	const char* text(int line, int* len) const;
+	void scroll_to(int pos);
+	void topline(int line);
+	int topline() const { return top() ? line_of(top()) : 0; }
+	void show_line(int line);
+	int select(int line, int val) { return valid(line) ? Fl_Browser_::select(item(line), val) : 0; }
+	int selected(int line) const { return valid(line) && _selected[line - 1]; }
+	int value() const { return selection() ? line_of(selection()) : 0; }
+
+	void stats(VirtualBrowserStats* stats) const;
+
+protected:
+	void* item_first() const override { return size() > 0 ? item(1) : nullptr; }
+	void* item_last() const override { return size() > 0 ? item(size()) : nullptr; }
+	void* item_next(void* p) const override { return line_of(p) < size() ? item(line_of(p) + 1) : nullptr; }
+	void* item_prev(void* p) const override { return line_of(p) > 1 ? item(line_of(p) - 1) : nullptr; }
+	void* item_at(int line) const override { return valid(line) ? item(line) : nullptr; }
+	int item_height(void* p) const override { return _heights.height(line_of(p) - 1); }
+	int item_quick_height(void* p) const override { return _heights.height(line_of(p) - 1); }
+	int item_width(void* p) const override;
+	void item_draw(void* p, int X, int Y, int W, int H) const override;
+	const char* item_text(void* p) const override;
+	void item_select(void* p, int val) override { _selected[line_of(p) - 1] = val != 0; }
+	int item_selected(void* p) const override { return _selected[line_of(p) - 1]; }
+
+	int full_height() const override;
+	int incr_height() const override { return _line_height; }
+
+	void draw() override;
+
+private:
+	static void* item(int line) { return (void*)(intptr_t)line; }
+	static int line_of(void* p) { return (int)(intptr_t)p; }
+	bool valid(int line) const { return line >= 1 && line <= size(); }
+
+	static void scrollbar_cb(Fl_Widget* w, void* data);
+
+	void seed(int pos);
+	void reserve(size_t bytes);
+	void grow(int n);
+	const char* line_text(int line, int* len) const;
+
+	VirtualBrowserFetchProc _fetch = nullptr;
+	void* _data = nullptr;
+	mutable std::vector<LineBlock> _cache;
+	mutable std::string _scratch;
+	mutable long long _hits = 0;
+	mutable long long _fetches = 0;
+
+	std::vector<char> _arena;    // NUL-terminated lines, back to back
+	std::vector<size_t> _starts;  // start of each line in _arena, plus the end
+
+	HeightIndex _heights;
+	std::vector<bool> _selected;
+	int _line_height;
+	bool _custom_heights = false;  // heights() was used, don't remeasure
+};
+
+Virtual_Browser::Virtual_Browser(int x, int y, int w, int h, const char* label): Fl_Browser_(x, y, w, h, label) {
+	_line_height = textsize() + 2;
+	_starts.push_back(0);
+	scrollbar.callback(scrollbar_cb);
+}
+
+// Lets D drop its data source, however the browser is deleted.
+Virtual_Browser::~Virtual_Browser() {
+	CallbackRegistry_ReleaseTree(this, 0);
+}
+
+void Virtual_Browser::clear() {
+	_fetch = nullptr;
+	_data = nullptr;
+	_cache.clear();
+	_arena.clear();
+	_starts.assign(1, 0);
+	_heights.assign(0, _line_height);
+	_selected.clear();
+	_custom_heights = false;
+	new_list();
+}
+
+// Room for bytes more in the arena, growing it geometrically so that loading
+// a file in many pieces doesn't copy it over and over.
+void Virtual_Browser::reserve(size_t bytes) {
+	size_t needed = _arena.size() + bytes;
+
+	if (needed > _arena.capacity())
+		_arena.reserve(needed > _arena.capacity() * 2 ? needed : _arena.capacity() * 2);
+}
+
+// New lines at the end all get the current line height.
+void Virtual_Browser::grow(int n) {
+	_heights.resize(n, _line_height);
+	_selected.resize(n, false);
+	redraw_lines();
+}
+
+// Appends text split at '\n' (a trailing "\r" is dropped) to the arena. A
+// line can't continue across calls.
+void Virtual_Browser::load(const char* text, size_t len) {
+	const char* end = text + len;
+
+	if (_fetch != nullptr)
+		clear();
+
+	int n = size();
+
+	reserve(len + 1);
+
+	while (text < end) {
+		const char* nl = (const char*)memchr(text, '\n', end - text);
+		const char* line_end = nl != nullptr ? nl : end;
+		size_t line_len = line_end - text;
+
+		if (line_len > 0 && text[line_len - 1] == '\r')
+			line_len--;
+
+		_arena.insert(_arena.end(), text, text + line_len);
+		_arena.push_back(0);
+		_starts.push_back(_arena.size());
+		n++;
+
+		text = nl != nullptr ? nl + 1 : end;
+	}
+
+	grow(n);
+}
+
+void Virtual_Browser::add(const DSlice* lines, size_t count) {
+	size_t bytes = 0;
+
+	if (_fetch != nullptr)
+		clear();
+
+	for (size_t i = 0; i < count; i++)
+		bytes += lines[i].length + 1;
+
+	reserve(bytes);
+
+	for (size_t i = 0; i < count; i++) {
+		_arena.insert(_arena.end(), lines[i].ptr, lines[i].ptr + lines[i].length);
+		_arena.push_back(0);
+		_starts.push_back(_arena.size());
+	}
+
+	grow(size() + (int)count);
+}
+
+// Lines come from fetch from now on; the arena is dropped.
+void Virtual_Browser::source(VirtualBrowserFetchProc fetch, void* data, int lines) {
+	clear();
+
+	if (fetch == nullptr)
+		return;
+
+	_fetch = fetch;
+	_data = data;
+	_cache.assign(VB_CACHE_BLOCKS, LineBlock{ -1, std::string(), std::vector<int>() });
+	grow(lines > 0 ? lines : 0);
+}
+
+// Changes the number of lines of the data source, keeping the others.
+void Virtual_Browser::lines(int n) {
+	if (_fetch == nullptr || n == size())
+		return;
+
+	if (n < 0)
+		n = 0;
+
+	// The last block may have been fetched short.
+	invalidate(size() < n ? size() : n, n > size() ? n : size());
+
+	// Items past the end may be referenced as top, selection or redraw line.
+	if (n < size()) {
+		_heights.resize(n, _line_height);
+		_selected.resize(n);
+		new_list();
+	} else {
+		grow(n);
+	}
+}
+
+// Lines first .. last of the data source changed.
+void Virtual_Browser::invalidate(int first, int last) {
+	for (LineBlock& b : _cache) {
+		if (b.block >= 0 && b.block * VB_BLOCK_LINES < last && first <= (b.block + 1) * VB_BLOCK_LINES)
+			b.block = -1;
+	}
+
+	redraw_lines();
+}
+
+void Virtual_Browser::heights(int first, const int* heights, int n) {
+	for (int k = 0; k < n; k++)
+		_heights.set(first - 1 + k, heights[k]);
+
+	_custom_heights = true;
+	seed(position());
+	redraw_lines();
+}
+
+// Line text and length (without the NUL), "" if the source failed.
+const char* Virtual_Browser::line_text(int line, int* len) const {
+	int index = line - 1;
+
+	if (_fetch == nullptr) {
+		*len = (int)(_starts[index + 1] - _starts[index] - 1);
+		return _arena.data() + _starts[index];
+	}
+
+	int block = index / VB_BLOCK_LINES;
+	LineBlock& b = _cache[block % VB_CACHE_BLOCKS];
+
+	if (b.block == block) {
+		_hits++;
+	} else {
+		int first = block * VB_BLOCK_LINES;
+		int count = size() - first < VB_BLOCK_LINES ? size() - first : VB_BLOCK_LINES;
+		const char* text;
+		const int* offsets;
+
+		_fetches++;
+		b.block = -1;
+
+		if (!_fetch(_data, first + 1, count, &text, &offsets)) {
+			*len = 0;
+			return "";
+		}
+
+		b.text.assign(text, offsets[count]);
+		b.offsets.assign(offsets, offsets + count + 1);
+		b.block = block;
+	}
+
+	int k = index - block * VB_BLOCK_LINES;
+
+	*len = b.offsets[k + 1] - b.offsets[k];
+	return b.text.data() + b.offsets[k];
+}
+
+const char* Virtual_Browser::text(int line, int* len) const {
+	if (!valid(line)) {
+		*len = 0;
+		return nullptr;
+	}
+
+	return line_text(line, len);
+}
+
+const char* Virtual_Browser::item_text(void* p) const {
+	int len;
+	const char* text = line_text(line_of(p), &len);
+
+	if (_fetch == nullptr)
+		return text;
+
+	_scratch.assign(text, len);
+	return _scratch.c_str();
+}
+
+int Virtual_Browser::item_width(void* p) const {
+	int len;
+	const char* text = line_text(line_of(p), &len);
+
+	fl_font(textfont(), textsize());
+	return (int)fl_width(text, len) + 4;
+}
+
+// Fl_Browser_::draw() has already filled the selection background.
+void Virtual_Browser::item_draw(void* p, int X, int Y, int W, int H) const {
+	int len;
+	const char* text = line_text(line_of(p), &len);
+	Fl_Color c = textcolor();
+
+	if (item_selected(p))
+		c = fl_contrast(c, selection_color());
+	if (!active_r())
+		c = fl_inactive(c);
+
+	fl_font(textfont(), textsize());
+	fl_color(c);
+	fl_draw(text, len, X + 2, Y + (H + fl_height()) / 2 - fl_descent());
+}
+
+int Virtual_Browser::full_height() const {
+	long long total = _heights.total();
+	return total < 0x7fffffff ? (int)total : 0x7fffffff;
+}
+
+// Points Fl_Browser_'s scroll cursor at the line covering pos, so update_top()
+// starts there instead of stepping from the old top line.
+void Virtual_Browser::seed(int pos) {
+	if (size() == 0)
+		return;
+
+	int index = _heights.item_at(pos);
+
+	this->*browser_member(BrowserTop()) = item(index + 1);
+	this->*browser_member(BrowserOffset()) = 0;
+	this->*browser_member(BrowserRealPosition()) = (int)_heights.offset(index);
+}
+
+void Virtual_Browser::scroll_to(int pos) {
+	int X, Y, W, H;
+	bbox(X, Y, W, H);
+
+	if (pos > full_height() - H)
+		pos = full_height() - H;
+	if (pos < 0)
+		pos = 0;
+
+	seed(pos);
+	position(pos);
+	redraw_lines();
+}
+
+void Virtual_Browser::topline(int line) {
+	if (valid(line))
+		scroll_to((int)_heights.offset(line - 1));
+}
+
+// Scrolls as little as needed to show the whole line.
+void Virtual_Browser::show_line(int line) {
+	if (!valid(line))
+		return;
+
+	int X, Y, W, H;
+	bbox(X, Y, W, H);
+
+	long long top = _heights.offset(line - 1);
+	long long bottom = top + _heights.height(line - 1);
+
+	if (top < position())
+		scroll_to((int)top);
+	else if (bottom > position() + H)
+		scroll_to((int)(bottom - H));
+}
+
+void Virtual_Browser::scrollbar_cb(Fl_Widget* w, void*) {
+	((Virtual_Browser*)w->parent())->scroll_to(int(((Fl_Scrollbar*)w)->value()));
+}
+
+void Virtual_Browser::draw() {
+	// The font is only known while drawing: remeasure the uniform height.
+	if (!_custom_heights) {
+		int h = fl_height(textfont(), textsize()) + 2;
+
+		if (h != _line_height) {
+			_line_height = h;
+			_heights.assign(size(), h);
+			seed(position());
+			clear_damage(FL_DAMAGE_ALL);
+		}
+	}
+
+	Fl_Browser_::draw();
+}
+
+void Virtual_Browser::stats(VirtualBrowserStats* stats) const {
+	stats->hits = _hits;
+	stats->fetches = _fetches;
+	stats->arena_bytes = (long long)_arena.size();
+	stats->lines = size();
+}
+
+extern "C" Virtual_Browser* VirtualBrowser_Create(int x, int y, int w, int h, const char* label = 0) {
+	return new Virtual_Browser(x, y, w, h, label);
+}
+
+extern "C" void VirtualBrowser_Clear(Virtual_Browser* b) {
+	b->clear();
+}
+
+extern "C" void VirtualBrowser_Load(Virtual_Browser* b, const char* text, size_t len) {
+	b->load(text, len);
+}
+
+extern "C" void VirtualBrowser_AddSlices(Virtual_Browser* b, const DSlice* lines, size_t count) {
+	b->add(lines, count);
+}
+
+extern "C" void VirtualBrowser_SetSource(Virtual_Browser* b, VirtualBrowserFetchProc fetch, void* data, int lines) {
+	b->source(fetch, data, lines);
+}
+
+extern "C" void VirtualBrowser_SetLines(Virtual_Browser* b, int lines) {
+	b->lines(lines);
+}
+
+extern "C" void VirtualBrowser_Invalidate(Virtual_Browser* b, int first, int last) {
+	b->invalidate(first, last);
+}
+
+extern "C" void VirtualBrowser_SetHeights(Virtual_Browser* b, int first, const int* heights, int n) {
+	b->heights(first, heights, n);
+}
+
+extern "C" int VirtualBrowser_Size(Virtual_Browser* b) {
+	return b->size();
+}
+
+extern "C" const char* VirtualBrowser_Text(Virtual_Browser* b, int line, int* len) {
+	return b->text(line, len);
+}
+
+extern "C" void VirtualBrowser_SetTopline(Virtual_Browser* b, int line) {
+	b->topline(line);
+}
+
+extern "C" int VirtualBrowser_Topline(Virtual_Browser* b) {
+	return b->topline();
+}
+
+extern "C" void VirtualBrowser_ShowLine(Virtual_Browser* b, int line) {
+	b->show_line(line);
+}
+
+extern "C" int VirtualBrowser_Select(Virtual_Browser* b, int line, int val) {
+	return b->select(line, val);
+}
+
+extern "C" int VirtualBrowser_Selected(Virtual_Browser* b, int line) {
+	return b->selected(line);
+}
+
+extern "C" int VirtualBrowser_Value(Virtual_Browser* b) {
+	return b->value();
+}
+
+extern "C" void VirtualBrowser_Stats(Virtual_Browser* b, VirtualBrowserStats* stats) {
+	b->stats(stats);
+}
@@ -0,0 +1,449 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/Fl_Group.H>
+#include <Fl/Fl_Scrollbar.H>
+#include <Fl/fl_draw.H>
+#include <vector>
+
+// Scrolling list of any number of items, shown through a small pool of row
+// widgets that are rebound to items as they scroll into view.
+//
+// Fl_Scroll keeps one child per item and moves, draws and offers events to all
+// of them, and derives its scrollbar from their bounding box. Virtual_List
+// only has as many rows as fill the viewport (plus one). Item i is always
+// shown by row i % pool size, so after a scroll the only rows that need the
+// D binder are the ones whose item actually changed; the others are just
+// moved. The scrollbar covers the virtual height of all items.
+//
+// Item heights are kept in a HeightIndex (a Fenwick tree): the item at a given
+// offset, the offset of an item and changing one height are all O(log n), so
+// scrolling and drawing cost the same for a hundred items or a hundred million.
+//
+// Rows that aren't needed for the current view are hidden, not deleted. A new
+// binder gets a new pool: rows made by the old one are deleted.
+
+#define VL_SCROLLBAR_SIZE 16
+
+// Creates one row widget; the list is the current group while it runs.
+typedef Fl_Widget* (*VirtualListCreateProc)(void* data);
+// Points row at item index (and resizes nothing: the list does that).
+typedef void (*VirtualListBindProc)(void* data, Fl_Widget* row, int index);
+
+struct VirtualListStats {
+	long long binds;
+	long long layouts;
+	int rows;     // row widgets created
+	int visible;  // rows showing an item
+};
+
+struct ListRow {
+	Fl_Widget* widget;
+	int index;  // -1 if unbound
+};
+
+class Virtual_List : public Fl_Group {
+public:
+	Virtual_List(int x, int y, int w, int h, const char* label = 0);
+	~Virtual_List();
+
+	void binder(VirtualListCreateProc create, VirtualListBindProc bind, void* data);
+	void count(int n, int height);
+	void heights(int first, const int* heights, int n);
+	void invalidate(int first, int last);
+	void scroll_to(long long offset);
+	void show_item(int index);
+	int top_item() const { return _heights.item_at(_offset); }
+
+	void resize(int x, int y, int w, int h) override;
+	int handle(int evt) override;
+
+	VirtualListStats stats = {};
+
+protected:
+	void draw() override;
+
+private:
+	static void scrollbar_cb(Fl_Widget* w, void* data);
+
+	void layout();
+	void update_scrollbar();
+	int view_x() const { return x() + Fl::box_dx(box()); }
+	int view_y() const { return y() + Fl::box_dy(box()); }
+	int view_w() const { return w() - Fl::box_dw(box()) - VL_SCROLLBAR_SIZE; }
+	int view_h() const { return h() - Fl::box_dh(box()); }
+
+	Fl_Scrollbar* _scrollbar;
+	VirtualListCreateProc _create = nullptr;
+	VirtualListBindProc _bind = nullptr;
+	void* _data = nullptr;
+
+	HeightIndex _heights;
+
+	long long _offset = 0;
+	std::vector<ListRow> _rows;
+};
+
+Virtual_List::Virtual_List(int x, int y, int w, int h, const char* label): Fl_Group(x, y, w, h, label) {
+	box(FL_DOWN_BOX);
+	color(FL_BACKGROUND2_COLOR);
+
+	_scrollbar = new Fl_Scrollbar(x + w - Fl::box_dx(box()) - VL_SCROLLBAR_SIZE, y + Fl::box_dy(box()),
+		VL_SCROLLBAR_SIZE, h - Fl::box_dh(box()));
+	_scrollbar->callback(scrollbar_cb, this);
+	end();
+}
+
+// D drops the binder and the row proxies, however the list is deleted.
+Virtual_List::~Virtual_List() {
+	CallbackRegistry_ReleaseTree(this, 0);
+}
+
+// create makes row widgets, bind points them at items.
+void Virtual_List::binder(VirtualListCreateProc create, VirtualListBindProc bind, void* data) {
+	if (create != _create || data != _data) {
+		// Deferred: this may run from the callback of a row.
+		for (ListRow& r : _rows) {
+			CallbackRegistry_ReleaseTree(r.widget, 0);
+			remove(r.widget);
+			Fl::delete_widget(r.widget);
+		}
+
+		_rows.clear();
+	}
+
+	_create = create;
+	_bind = bind;
+	_data = data;
+
+	for (ListRow& r : _rows)
+		r.index = -1;
+
+	layout();
+}
+
+// n items, all height pixels high.
+void Virtual_List::count(int n, int height) {
+	_heights.assign(n, height);
+
+	for (ListRow& r : _rows)
+		r.index = -1;
+
+	if (_offset > _heights.total())
+		_offset = _heights.total();
+
+	layout();
+}
+
+// Sets the heights of items first .. first + n - 1.
+void Virtual_List::heights(int first, const int* heights, int n) {
+	for (int k = 0; k < n; k++)
+		_heights.set(first + k, heights[k]);
+
+	layout();
+}
+
+// Items first .. last changed: the rows showing them are bound again.
+void Virtual_List::invalidate(int first, int last) {
+	for (ListRow& r : _rows) {
+		if (r.index >= first && r.index <= last)
+			r.index = -1;
+	}
+
+	layout();
+}
+
+void Virtual_List::scroll_to(long long offset) {
+	long long max = _heights.total() - view_h();
+
+	if (offset > max)
+		offset = max;
+	if (offset < 0)
+		offset = 0;
+
+	if (offset == _offset)
+		return;
+
+	_offset = offset;
+	layout();
+}
+
+// Scrolls as little as needed to show the whole item.
+void Virtual_List::show_item(int index) {
+	if (index < 0 || index >= _heights.count())
+		return;
+
+	long long top = _heights.offset(index);
+	long long bottom = top + _heights.height(index);
+
+	if (top < _offset)
+		scroll_to(top);
+	else if (bottom > _offset + view_h())
+		scroll_to(bottom - view_h());
+}
+
+void Virtual_List::resize(int x, int y, int w, int h) {
+	Fl_Widget::resize(x, y, w, h);
+	_scrollbar->resize(x + w - Fl::box_dx(box()) - VL_SCROLLBAR_SIZE, y + Fl::box_dy(box()),
+		VL_SCROLLBAR_SIZE, h - Fl::box_dh(box()));
+	layout();
+}
+
+// Binds and positions the rows for the current offset.
+void Virtual_List::layout() {
+	int count = _heights.count();
+	int first = count > 0 ? _heights.item_at(_offset) : 0;
+	int needed = 0;
+	int X = view_x(), Y = view_y(), W = view_w(), H = view_h();
+
+	stats.layouts++;
+
+	// How many items the view shows from here on.
+	for (long long y = _heights.offset(first) - _offset; needed < count - first && y < H; needed++)
+		y += _heights.height(first + needed);
+
+	// Not enough rows: grow the pool. The item -> row mapping changes with the
+	// pool size, so everything is bound again (this only happens a few times).
+	if (needed > (int)_rows.size() && _create != nullptr) {
+		Fl_Group* current = Fl_Group::current();
+		size_t size = needed + 1;
+
+		begin();
+
+		while (_rows.size() < size) {
+			Fl_Widget* w = _create(_data);
+
+			if (w == nullptr)
+				break;
+
+			if (w->parent() != this)
+				add(w);
+
+			_rows.push_back(ListRow{ w, -1 });
+		}
+
+		Fl_Group::current(current);
+
+		for (ListRow& r : _rows)
+			r.index = -1;
+	}
+
+	int pool = (int)_rows.size();
+	long long y = _heights.offset(first) - _offset;
+
+	if (needed > pool)
+		needed = pool;
+
+	stats.rows = pool;
+	stats.visible = needed;
+
+	for (int k = 0; k < pool; k++) {
+		int index = first + k;
+		ListRow& r = _rows[index % pool];
+
+		// The slots left over have no item in view.
+		if (k >= needed) {
+			r.widget->hide();
+			continue;
+		}
+
+		if (r.index != index) {
+			r.index = index;
+
+			if (_bind != nullptr)
+				_bind(_data, r.widget, index);
+
+			stats.binds++;
+		}
+
+		r.widget->resize(X, Y + (int)y, W, _heights.height(index));
+		r.widget->show();
+		y += _heights.height(index);
+	}
+
+	update_scrollbar();
+	redraw();
+}
+
+void Virtual_List::update_scrollbar() {
+	long long all = _heights.total();
+	int H = view_h();
+
+	// Fl_Scrollbar works in ints; scale huge lists down.
+	double scale = all > 0x3fffffff ? (double)all / 0x3fffffff : 1.0;
+
+	_scrollbar->value((int)(_offset / scale), (int)(H / scale), 0, (int)(all / scale));
+	_scrollbar->linesize(_heights.count() > 0 ? (int)(_heights.height(top_item()) / scale) + 1 : 1);
+}
+
+void Virtual_List::scrollbar_cb(Fl_Widget* w, void* data) {
+	Virtual_List* l = (Virtual_List*)data;
+	long long all = l->_heights.total();
+	double scale = all > 0x3fffffff ? (double)all / 0x3fffffff : 1.0;
+
+	l->scroll_to((long long)(((Fl_Scrollbar*)w)->value() * scale));
+}
+
+int Virtual_List::handle(int evt) {
+	if (evt == FL_MOUSEWHEEL && Fl::event_dy() != 0 && Fl::event_inside(view_x(), view_y(), view_w(), view_h())) {
+		// Rows get the wheel first (a spinner may want it).
+		if (Fl_Group::handle(evt))
+			return 1;
+
+		int line = _heights.count() > 0 ? _heights.height(top_item()) : 0;
+		scroll_to(_offset + (long long)Fl::event_dy() * 3 * line);
+		return 1;
+	}
+
+	return Fl_Group::handle(evt);
+}
+
+void Virtual_List::draw() {
+	int X = view_x(), Y = view_y(), W = view_w(), H = view_h();
+
+	if (damage() & ~FL_DAMAGE_CHILD) {
+		draw_box();
+		draw_label();
+	}
+
+	fl_push_clip(X, Y, W, H);
+
+	if (damage() & ~FL_DAMAGE_CHILD) {
+		fl_color(color());
+		fl_rectf(X, Y, W, H);
+	}
+
+	for (ListRow& r : _rows) {
+		if (r.widget->visible()) {
+			if (damage() & ~FL_DAMAGE_CHILD)
+				draw_child(*r.widget);
+			else
+				update_child(*r.widget);
+		}
+	}
+
+	fl_pop_clip();
+
+	if (damage() & ~FL_DAMAGE_CHILD)
+		draw_child(*_scrollbar);
+	else
+		update_child(*_scrollbar);
+}
+
+void HeightIndex::assign(int n, int height) {
+	_count = n > 0 ? n : 0;
+	_height.assign(_count, height);
+	_tree.assign(_count + 1, 0);
+
+	for (_mask = 1; _mask * 2 <= _count; _mask *= 2) {
+	}
+
+	// O(n) build: every node passes its sum on to its parent.
+	for (int i = 1; i <= _count; i++) {
+		_tree[i] += height;
+
+		int parent = i + (i & -i);
+		if (parent <= _count)
+			_tree[parent] += _tree[i];
+	}
+}
+
+void HeightIndex::resize(int n, int height) {
+	if (n < 0)
+		n = 0;
+
+	// Node i only covers items up to i, so truncating keeps the rest valid.
+	if (n < _count) {
+		_count = n;
+		_height.resize(n);
+		_tree.resize(n + 1);
+
+		for (_mask = 1; _mask * 2 <= _count; _mask *= 2) {
+		}
+	}
+
+	while (_count < n)
+		push(height);
+}
+
+// Appends one item in O(log n): node i sums the items after i - lowbit(i).
+void HeightIndex::push(int height) {
+	int i = ++_count;
+
+	if (_tree.empty())
+		_tree.push_back(0);
+
+	_height.push_back(height);
+	_tree.push_back(height + offset(i - 1) - offset(i - (i & -i)));
+
+	if (_mask * 2 <= _count)
+		_mask *= 2;
+}
+
+void HeightIndex::set(int index, int height) {
+	if (index < 0 || index >= _count)
+		return;
+
+	long long delta = height - _height[index];
+	_height[index] = height;
+
+	for (int j = index + 1; j <= _count; j += j & -j)
+		_tree[j] += delta;
+}
+
+long long HeightIndex::offset(int index) const {
+	long long sum = 0;
+
+	for (int j = index; j > 0; j -= j & -j)
+		sum += _tree[j];
+
+	return sum;
+}
+
+// Item covering offset: the last one whose start is <= offset.
+int HeightIndex::item_at(long long offset) const {
+	int pos = 0;
+
+	for (int step = _mask; step > 0; step /= 2) {
+		if (pos + step <= _count && _tree[pos + step] <= offset) {
+			pos += step;
+			offset -= _tree[pos];
+		}
+	}
+
+	return pos < _count ? pos : _count - 1;
+}
+
+extern "C" Virtual_List* VirtualList_Create(int x, int y, int w, int h, const char* label = 0) {
+	return new Virtual_List(x, y, w, h, label);
+}
+
+extern "C" void VirtualList_SetBinder(Virtual_List* l, VirtualListCreateProc create, VirtualListBindProc bind, void* data) {
+	l->binder(create, bind, data);
+}
+
+extern "C" void VirtualList_SetCount(Virtual_List* l, int count, int height) {
+	l->count(count, height);
+}
+
+extern "C" void VirtualList_SetHeights(Virtual_List* l, int first, const int* heights, int n) {
+	l->heights(first, heights, n);
+}
+
+extern "C" void VirtualList_Invalidate(Virtual_List* l, int first, int last) {
+	l->invalidate(first, last);
+}
+
+extern "C" void VirtualList_ScrollTo(Virtual_List* l, long long offset) {
+	l->scroll_to(offset);
+}
+
+extern "C" void VirtualList_ShowItem(Virtual_List* l, int index) {
+	l->show_item(index);
+}
+
+extern "C" int VirtualList_TopItem(Virtual_List* l) {
+	return l->top_item();
+}
+
+extern "C" void VirtualList_Stats(Virtual_List* l, VirtualListStats* stats) {
+	*stats = l->stats;
+}
@@ -0,0 +1,313 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/Fl_Table_Row.H>
+#include <Fl/fl_draw.H>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <iterator>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Fl_Table_Row whose cells come from a D data provider.
+//
+// Cell text is fetched in blocks of VT_BLOCK_ROWS x VT_BLOCK_COLS cells with a
+// single call into D, and kept in a bounded LRU cache of blocks. At
+// CONTEXT_STARTPAGE all blocks covering the visible range are fetched up front,
+// so drawing the page afterwards doesn't cross into D at all. Scrolling one
+// row typically touches no new block.
+//
+// Fl_Table already only asks for visible cells and keeps its scroll
+// bookkeeping O(1) for huge row counts (Ori Berger's >500k row work), so with
+// the cache the cost of a repaint depends on the viewport, not on rows().
+//
+// invalidate() drops only the blocks that intersect the changed range and
+// redraws just that range through redraw_range().
+
+#define VT_BLOCK_ROWS 64
+#define VT_BLOCK_COLS 16
+#define VT_DEFAULT_CACHE_BLOCKS 256
+
+// Fills *text with the cells of the block, row-major and concatenated, and
+// *offsets with rows*cols+1 byte offsets into it. Both stay owned by D and only
+// have to remain valid until the call returns. Returns 0 on failure.
+typedef int (*VirtualTableFetchProc)(void* data, int row, int rows, int col, int cols,
+		const char** text, const int** offsets);
+
+struct VirtualTableStats {
+	long long hits;
+	long long misses;
+	long long fetches;
+	long long evictions;
+	int cached_blocks;
+};
+
+struct CellBlock {
+	uint64_t key;
+	int rows;
+	int cols;
+	std::string text;          // NUL-terminated cells, back to back
+	std::vector<int> offsets;  // start of each cell in text
+};
+
+class Virtual_Table : public Fl_Table_Row {
+public:
+	Virtual_Table(int x, int y, int w, int h, const char* label = 0);
+	~Virtual_Table();
+
+	void provider(VirtualTableFetchProc fetch, void* data);
+	void cache_blocks(int n);
+	void invalidate(int top_row, int bottom_row, int left_col, int right_col);
+	void invalidate_all();
+	void col_header_text(int col, const char* text);
+	int cached_blocks() const { return (int)_lru.size(); }
+
+	void rows(int val) override;
+	void cols(int val) override;
+	int rows() { return Fl_Table_Row::rows(); }
+	int cols() { return Fl_Table_Row::cols(); }
+
+	VirtualTableStats stats;
+
+protected:
+	void draw_cell(TableContext context, int R, int C, int X, int Y, int W, int H) override;
+
+private:
+	static uint64_t block_key(int block_row, int block_col) {
+		return ((uint64_t)(uint32_t)block_row << 32) | (uint32_t)block_col;
+	}
+
+	CellBlock* block(int R, int C);
+	const char* cell_text(int R, int C);
+
+	VirtualTableFetchProc _fetch = nullptr;
+	void* _data = nullptr;
+
+	std::list<CellBlock> _lru;  // most recently used first
+	std::unordered_map<uint64_t, std::list<CellBlock>::iterator> _blocks;
+	int _max_blocks = VT_DEFAULT_CACHE_BLOCKS;
+
+	std::vector<std::string> _col_headers;
+};
+
+Virtual_Table::Virtual_Table(int x, int y, int w, int h, const char* label): Fl_Table_Row(x, y, w, h, label) {
+	memset(&stats, 0, sizeof(stats));
+	end();
+}
+
+// Also when a parent group deletes the table: D lets go of its data source.
+Virtual_Table::~Virtual_Table() {
+	CallbackRegistry_ReleaseTree(this, 0);
+}
+
+void Virtual_Table::provider(VirtualTableFetchProc fetch, void* data) {
+	_fetch = fetch;
+	_data = data;
+	invalidate_all();
+}
+
+void Virtual_Table::cache_blocks(int n) {
+	_max_blocks = n > 1 ? n : 1;
+
+	while ((int)_lru.size() > _max_blocks) {
+		_blocks.erase(_lru.back().key);
+		_lru.pop_back();
+		stats.evictions++;
+	}
+}
+
+void Virtual_Table::rows(int val) {
+	Fl_Table_Row::rows(val);
+	invalidate_all();
+}
+
+void Virtual_Table::cols(int val) {
+	Fl_Table_Row::cols(val);
+	invalidate_all();
+}
+
+void Virtual_Table::invalidate_all() {
+	_lru.clear();
+	_blocks.clear();
+	redraw();
+}
+
+void Virtual_Table::invalidate(int top_row, int bottom_row, int left_col, int right_col) {
+	for (auto it = _lru.begin(); it != _lru.end();) {
+		int r0 = (int)(it->key >> 32) * VT_BLOCK_ROWS;
+		int c0 = (int)(uint32_t)it->key * VT_BLOCK_COLS;
+
+		if (r0 <= bottom_row && top_row < r0 + VT_BLOCK_ROWS
+				&& c0 <= right_col && left_col < c0 + VT_BLOCK_COLS) {
+			_blocks.erase(it->key);
+			it = _lru.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	redraw_range(top_row, bottom_row, left_col, right_col);
+}
+
+void Virtual_Table::col_header_text(int col, const char* text) {
+	if (col < 0)
+		return;
+
+	if ((int)_col_headers.size() <= col)
+		_col_headers.resize(col + 1);
+
+	_col_headers[col] = text != nullptr ? text : "";
+	redraw();
+}
+
+CellBlock* Virtual_Table::block(int R, int C) {
+	int block_row = R / VT_BLOCK_ROWS;
+	int block_col = C / VT_BLOCK_COLS;
+	uint64_t key = block_key(block_row, block_col);
+	auto found = _blocks.find(key);
+
+	if (found != _blocks.end()) {
+		stats.hits++;
+		_lru.splice(_lru.begin(), _lru, found->second);
+		return &*found->second;
+	}
+
+	stats.misses++;
+
+	if (_fetch == nullptr)
+		return nullptr;
+
+	int row = block_row * VT_BLOCK_ROWS;
+	int col = block_col * VT_BLOCK_COLS;
+	int nrows = rows() - row < VT_BLOCK_ROWS ? rows() - row : VT_BLOCK_ROWS;
+	int ncols = cols() - col < VT_BLOCK_COLS ? cols() - col : VT_BLOCK_COLS;
+	const char* text = nullptr;
+	const int* offsets = nullptr;
+
+	stats.fetches++;
+
+	if (nrows <= 0 || ncols <= 0 || !_fetch(_data, row, nrows, col, ncols, &text, &offsets))
+		return nullptr;
+
+	// Reuse the least recently used block's storage once the cache is full.
+	if ((int)_lru.size() >= _max_blocks) {
+		_blocks.erase(_lru.back().key);
+		_lru.splice(_lru.begin(), _lru, std::prev(_lru.end()));
+		stats.evictions++;
+	} else {
+		_lru.emplace_front();
+	}
+
+	CellBlock& b = _lru.front();
+	int cells = nrows * ncols;
+
+	b.key = key;
+	b.rows = nrows;
+	b.cols = ncols;
+	b.text.clear();
+	b.text.reserve(offsets[cells] - offsets[0] + cells);
+	b.offsets.resize(cells);
+
+	for (int i = 0; i < cells; i++) {
+		b.offsets[i] = (int)b.text.size();
+		b.text.append(text + offsets[i], offsets[i + 1] - offsets[i]);
+		b.text.push_back('\0');
+	}
+
+	_blocks[key] = _lru.begin();
+	return &b;
+}
+
+const char* Virtual_Table::cell_text(int R, int C) {
+	CellBlock* b = block(R, C);
+
+	if (b == nullptr)
+		return "";
+
+	int i = (R % VT_BLOCK_ROWS) * b->cols + (C % VT_BLOCK_COLS);
+	return b->text.c_str() + b->offsets[i];
+}
+
+void Virtual_Table::draw_cell(TableContext context, int R, int C, int X, int Y, int W, int H) {
+	char s[32];
+
+	switch (context) {
+	case CONTEXT_STARTPAGE:
+		// Fetch every block of the page now rather than while drawing it.
+		if (toprow < 0 || leftcol < 0)
+			break;
+
+		for (int r = toprow - toprow % VT_BLOCK_ROWS; r <= botrow; r += VT_BLOCK_ROWS)
+			for (int c = leftcol - leftcol % VT_BLOCK_COLS; c <= rightcol; c += VT_BLOCK_COLS)
+				block(r, c);
+		break;
+
+	case CONTEXT_COL_HEADER:
+		fl_push_clip(X, Y, W, H);
+		fl_draw_box(FL_THIN_UP_BOX, X, Y, W, H, col_header_color());
+		fl_color(FL_BLACK);
+
+		if (C < (int)_col_headers.size()) {
+			fl_draw(_col_headers[C].c_str(), X, Y, W, H, FL_ALIGN_CENTER);
+		} else {
+			snprintf(s, sizeof(s), "%d", C);
+			fl_draw(s, X, Y, W, H, FL_ALIGN_CENTER);
+		}
+
+		fl_pop_clip();
+		break;
+
+	case CONTEXT_ROW_HEADER:
+		fl_push_clip(X, Y, W, H);
+		fl_draw_box(FL_THIN_UP_BOX, X, Y, W, H, row_header_color());
+		fl_color(FL_BLACK);
+		snprintf(s, sizeof(s), "%d", R);
+		fl_draw(s, X, Y, W, H, FL_ALIGN_CENTER);
+		fl_pop_clip();
+		break;
+
+	case CONTEXT_CELL:
+		fl_push_clip(X, Y, W, H);
+		fl_color(row_selected(R) ? selection_color() : color());
+		fl_rectf(X, Y, W, H);
+		fl_color(FL_BLACK);
+		fl_draw(cell_text(R, C), X + 2, Y, W - 4, H, FL_ALIGN_LEFT);
+		fl_color(FL_LIGHT2);
+		fl_rect(X, Y, W, H);
+		fl_pop_clip();
+		break;
+
+	default:
+		break;
+	}
+}
+
+extern "C" Virtual_Table* VirtualTable_Create(int x, int y, int w, int h, const char* label = 0) {
+	return new Virtual_Table(x, y, w, h, label);
+}
+
+extern "C" void VirtualTable_SetProvider(Virtual_Table* t, VirtualTableFetchProc fetch, void* data) {
+	t->provider(fetch, data);
+}
+
+extern "C" void VirtualTable_SetCacheBlocks(Virtual_Table* t, int blocks) {
+	t->cache_blocks(blocks);
+}
+
+extern "C" void VirtualTable_Invalidate(Virtual_Table* t, int top_row, int bottom_row, int left_col, int right_col) {
+	t->invalidate(top_row, bottom_row, left_col, right_col);
+}
+
+extern "C" void VirtualTable_InvalidateAll(Virtual_Table* t) {
+	t->invalidate_all();
+}
+
+extern "C" void VirtualTable_SetColHeader(Virtual_Table* t, int col, const char* text) {
+	t->col_header_text(col, text);
+}
+
+extern "C" void VirtualTable_Stats(Virtual_Table* t, VirtualTableStats* stats) {
+	*stats = t->stats;
+	stats->cached_blocks = t->cached_blocks();
+}
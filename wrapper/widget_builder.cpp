@@ -0,0 +1,501 @@
+#include "fltk_d_wrapper.h"
+#include <Fl/Fl_Window.H>
+#include <Fl/Fl_Double_Window.H>
+#include <Fl/Fl_Group.H>
+#include <Fl/Fl_Pack.H>
+#include <Fl/Fl_Scroll.H>
+#include <Fl/Fl_Box.H>
+#include <Fl/Fl_Button.H>
+#include <Fl/Fl_Check_Button.H>
+#include <Fl/Fl_Light_Button.H>
+#include <Fl/Fl_Input.H>
+#include <Fl/Fl_Value_Input.H>
+#include <Fl/Fl_Value_Output.H>
+#include <Fl/Fl_Choice.H>
+#include <Fl/Fl_Progress.H>
+#include <Fl/Fl_Text_Display.H>
+#include <Fl/Fl_Text_Editor.H>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Builds a whole widget hierarchy from a layout description in one call.
+//
+// The description is parsed once into a template, which can then be
+// instantiated any number of times. Each line creates one widget:
+//
+//     window 0 0 400 300 "Settings"
+//       group 10 10 380 240 "General" box=FL_DOWN_BOX
+//         input 100 20 200 25 "Name" @name tooltip="Full name"
+//         button 300 260 90 25 "OK" @ok resizable
+//       end
+//     end
+//
+// A container (window, double_window, group, pack, scroll) collects the lines
+// up to its "end". Coordinates of a template instance are offset by dx, dy,
+// except inside a window of the template, whose children are placed relative
+// to it.
+// Attributes are box, color, selection_color, labelcolor, labelfont,
+// labelsize, labeltype, align, when, type, tooltip, and the flags resizable,
+// hide and deactivate. Values are numbers, FL_ names, #rrggbb colors, or
+// names joined with '|'. Indentation and '#' comments are ignored.
+//
+// Widgets marked @name are written to the caller's handle table in the order
+// they first appear, so D only creates proxies for the widgets it touches.
+
+enum BuilderKind {
+	BUILD_WINDOW,
+	BUILD_DOUBLE_WINDOW,
+	BUILD_GROUP,
+	BUILD_PACK,
+	BUILD_SCROLL,
+	BUILD_BOX,
+	BUILD_BUTTON,
+	BUILD_CHECK_BUTTON,
+	BUILD_LIGHT_BUTTON,
+	BUILD_INPUT,
+	BUILD_VALUE_INPUT,
+	BUILD_VALUE_OUTPUT,
+	BUILD_CHOICE,
+	BUILD_PROGRESS,
+	BUILD_TEXT_DISPLAY,
+	BUILD_TEXT_EDITOR,
+	BUILD_END,
+};
+
+static const char* kind_names[] = {
+	"window", "double_window", "group", "pack", "scroll", "box", "button",
+	"check_button", "light_button", "input", "value_input", "value_output",
+	"choice", "progress", "text_display", "text_editor", "end",
+};
+
+enum BuilderAttr {
+	ATTR_BOX,
+	ATTR_COLOR,
+	ATTR_SELECTION_COLOR,
+	ATTR_LABELCOLOR,
+	ATTR_LABELFONT,
+	ATTR_LABELSIZE,
+	ATTR_LABELTYPE,
+	ATTR_ALIGN,
+	ATTR_WHEN,
+	ATTR_TYPE,
+	ATTR_RESIZABLE,
+	ATTR_HIDE,
+	ATTR_DEACTIVATE,
+	ATTR_COUNT,
+};
+
+static const char* attr_names[] = {
+	"box", "color", "selection_color", "labelcolor", "labelfont", "labelsize",
+	"labeltype", "align", "when", "type", "resizable", "hide", "deactivate",
+};
+
+struct BuilderConstant {
+	const char* name;
+	unsigned value;
+};
+
+static const BuilderConstant constants[] = {
+	{ "FL_NO_BOX", FL_NO_BOX }, { "FL_FLAT_BOX", FL_FLAT_BOX }, { "FL_UP_BOX", FL_UP_BOX },
+	{ "FL_DOWN_BOX", FL_DOWN_BOX }, { "FL_THIN_UP_BOX", FL_THIN_UP_BOX },
+	{ "FL_THIN_DOWN_BOX", FL_THIN_DOWN_BOX }, { "FL_ENGRAVED_BOX", FL_ENGRAVED_BOX },
+	{ "FL_EMBOSSED_BOX", FL_EMBOSSED_BOX }, { "FL_BORDER_BOX", FL_BORDER_BOX },
+	{ "FL_ENGRAVED_FRAME", FL_ENGRAVED_FRAME }, { "FL_EMBOSSED_FRAME", FL_EMBOSSED_FRAME },
+	{ "FL_BORDER_FRAME", FL_BORDER_FRAME }, { "FL_UP_FRAME", FL_UP_FRAME },
+	{ "FL_DOWN_FRAME", FL_DOWN_FRAME },
+
+	{ "FL_FOREGROUND_COLOR", FL_FOREGROUND_COLOR }, { "FL_BACKGROUND_COLOR", FL_BACKGROUND_COLOR },
+	{ "FL_BACKGROUND2_COLOR", FL_BACKGROUND2_COLOR }, { "FL_SELECTION_COLOR", FL_SELECTION_COLOR },
+	{ "FL_INACTIVE_COLOR", FL_INACTIVE_COLOR }, { "FL_BLACK", FL_BLACK }, { "FL_WHITE", FL_WHITE },
+	{ "FL_RED", FL_RED }, { "FL_GREEN", FL_GREEN }, { "FL_BLUE", FL_BLUE },
+	{ "FL_YELLOW", FL_YELLOW }, { "FL_MAGENTA", FL_MAGENTA }, { "FL_CYAN", FL_CYAN },
+	{ "FL_DARK_RED", FL_DARK_RED }, { "FL_GRAY", FL_GRAY },
+
+	{ "FL_HELVETICA", FL_HELVETICA }, { "FL_HELVETICA_BOLD", FL_HELVETICA_BOLD },
+	{ "FL_COURIER", FL_COURIER }, { "FL_COURIER_BOLD", FL_COURIER_BOLD },
+	{ "FL_TIMES", FL_TIMES }, { "FL_TIMES_BOLD", FL_TIMES_BOLD },
+
+	// FL_SHADOW_LABEL and friends are function calls, not constants.
+	{ "FL_NORMAL_LABEL", FL_NORMAL_LABEL }, { "FL_NO_LABEL", FL_NO_LABEL },
+
+	{ "FL_ALIGN_CENTER", FL_ALIGN_CENTER }, { "FL_ALIGN_TOP", FL_ALIGN_TOP },
+	{ "FL_ALIGN_BOTTOM", FL_ALIGN_BOTTOM }, { "FL_ALIGN_LEFT", FL_ALIGN_LEFT },
+	{ "FL_ALIGN_RIGHT", FL_ALIGN_RIGHT }, { "FL_ALIGN_INSIDE", FL_ALIGN_INSIDE },
+	{ "FL_ALIGN_CLIP", FL_ALIGN_CLIP }, { "FL_ALIGN_WRAP", FL_ALIGN_WRAP },
+
+	{ "FL_WHEN_NEVER", FL_WHEN_NEVER }, { "FL_WHEN_CHANGED", FL_WHEN_CHANGED },
+	{ "FL_WHEN_RELEASE", FL_WHEN_RELEASE }, { "FL_WHEN_ENTER_KEY", FL_WHEN_ENTER_KEY },
+	{ "FL_WHEN_NOT_CHANGED", FL_WHEN_NOT_CHANGED },
+
+	{ "FL_VERTICAL", 0 }, { "FL_HORIZONTAL", 1 },
+};
+
+struct BuilderNode {
+	int kind = BUILD_END;
+	int x = 0, y = 0, w = 0, h = 0;
+	int handle = -1;  // index in the handle table, or -1
+	std::string label;
+	std::string tooltip;
+	std::vector<std::pair<int, unsigned>> attrs;
+};
+
+struct WidgetTemplate {
+	std::vector<BuilderNode> nodes;  // pre-order, containers closed by BUILD_END
+	std::vector<std::string> handles;
+};
+
+static char builder_error[256];
+
+static bool parse_constant(const std::string& s, unsigned* value) {
+	size_t start = 0;
+
+	*value = 0;
+
+	while (start <= s.size()) {
+		size_t bar = s.find('|', start);
+		std::string part = s.substr(start, bar == std::string::npos ? std::string::npos : bar - start);
+		char* end;
+		bool found = false;
+
+		if (part.size() == 7 && part[0] == '#') {
+			unsigned long rgb = strtoul(part.c_str() + 1, &end, 16);
+
+			if (*end != '\0')
+				return false;
+
+			*value |= fl_rgb_color((uchar)(rgb >> 16), (uchar)(rgb >> 8), (uchar)rgb);
+			found = true;
+		} else if (!part.empty() && (isdigit((unsigned char)part[0]) || part[0] == '-')) {
+			*value |= (unsigned)strtol(part.c_str(), &end, 0);
+
+			if (*end != '\0')
+				return false;
+
+			found = true;
+		} else {
+			for (const BuilderConstant& c : constants) {
+				if (part == c.name) {
+					*value |= c.value;
+					found = true;
+					break;
+				}
+			}
+		}
+
+		if (!found)
+			return false;
+
+		if (bar == std::string::npos)
+			break;
+
+		start = bar + 1;
+	}
+
+	return true;
+}
+
+// Splits a line into words; quoted words may contain spaces and \" escapes.
+// quoted[i] is where the first quoted part of words[i] starts, npos if none,
+// so that tooltip="a=b" still splits at its first '=' and "hide" stays text.
+static bool tokenize(const char* p, const char* e, std::vector<std::string>& words, std::vector<size_t>& quoted) {
+	words.clear();
+	quoted.clear();
+
+	while (p < e) {
+		while (p < e && (*p == ' ' || *p == '\t' || *p == '\r'))
+			p++;
+
+		if (p >= e || *p == '#')
+			break;
+
+		std::string word;
+		size_t quote = std::string::npos;
+
+		while (p < e && *p != ' ' && *p != '\t' && *p != '\r') {
+			if (*p != '"') {
+				word += *p++;
+				continue;
+			}
+
+			if (quote == std::string::npos)
+				quote = word.size();
+
+			for (p++; p < e && *p != '"'; p++) {
+				if (*p == '\\' && p + 1 < e)
+					p++;
+				word += *p;
+			}
+
+			if (p >= e)
+				return false;
+
+			p++;
+		}
+
+		words.push_back(word);
+		quoted.push_back(quote);
+	}
+
+	return true;
+}
+
+static WidgetTemplate* parse_error(WidgetTemplate* t, int line, const char* what) {
+	snprintf(builder_error, sizeof(builder_error), "line %d: %s", line, what);
+	delete t;
+	return nullptr;
+}
+
+// Parses a layout description. Returns null on error, see WidgetBuilder_Error().
+extern "C" WidgetTemplate* WidgetBuilder_Parse(const char* text, size_t length) {
+	WidgetTemplate* t = new WidgetTemplate();
+	std::vector<std::string> words;
+	std::vector<size_t> quoted;
+	const char* p = text;
+	const char* end = text + length;
+	int depth = 0, line = 0;
+
+	builder_error[0] = '\0';
+
+	while (p < end) {
+		const char* eol = (const char*)memchr(p, '\n', end - p);
+
+		if (eol == nullptr)
+			eol = end;
+
+		line++;
+
+		if (!tokenize(p, eol, words, quoted))
+			return parse_error(t, line, "unterminated string");
+
+		p = eol + 1;
+
+		if (words.empty())
+			continue;
+
+		BuilderNode node;
+		int kind = -1;
+
+		for (int k = 0; k <= BUILD_END && quoted[0] == std::string::npos; k++) {
+			if (words[0] == kind_names[k]) {
+				kind = k;
+				break;
+			}
+		}
+
+		if (kind < 0)
+			return parse_error(t, line, "unknown widget type");
+
+		node.kind = kind;
+		node.handle = -1;
+
+		if (kind == BUILD_END) {
+			if (--depth < 0)
+				return parse_error(t, line, "'end' without a container");
+
+			t->nodes.push_back(node);
+			continue;
+		}
+
+		if (words.size() < 5)
+			return parse_error(t, line, "expected x y w h");
+
+		int* xywh[] = { &node.x, &node.y, &node.w, &node.h };
+
+		for (int i = 0; i < 4; i++) {
+			char* e;
+			*xywh[i] = (int)strtol(words[i + 1].c_str(), &e, 10);
+
+			if (*e != '\0' || quoted[i + 1] != std::string::npos)
+				return parse_error(t, line, "bad coordinate");
+		}
+
+		bool first_word = true;
+
+		for (size_t i = 5; i < words.size(); i++) {
+			const std::string& w = words[i];
+			size_t quote = quoted[i];
+			size_t eq = w.find('=');
+
+			// Quoted text is a label or an attribute value, never a name.
+			if (eq != std::string::npos && eq >= quote)
+				eq = std::string::npos;
+
+			if (w[0] == '@' && quote != 0) {
+				node.handle = (int)t->handles.size();
+				t->handles.push_back(w.substr(1));
+				continue;
+			}
+
+			// The first word after the coordinates (and the @name) is the label
+			// unless it is an attribute.
+			bool label = first_word && eq == std::string::npos &&
+				(quote != std::string::npos || (w != "resizable" && w != "hide" && w != "deactivate"));
+
+			first_word = false;
+
+			if (label) {
+				node.label = w;
+				continue;
+			}
+
+			if (eq == std::string::npos && quote != std::string::npos)
+				return parse_error(t, line, "unexpected string");
+
+			std::string name = w.substr(0, eq);
+			int attr = -1;
+
+			if (name == "tooltip" && eq != std::string::npos) {
+				node.tooltip = w.substr(eq + 1);
+				continue;
+			}
+
+			for (int a = 0; a < ATTR_COUNT; a++) {
+				if (name == attr_names[a]) {
+					attr = a;
+					break;
+				}
+			}
+
+			if (attr < 0)
+				return parse_error(t, line, "unknown attribute");
+
+			unsigned value = 1;
+
+			if (attr < ATTR_RESIZABLE && (eq == std::string::npos || !parse_constant(w.substr(eq + 1), &value)))
+				return parse_error(t, line, "bad attribute value");
+
+			node.attrs.emplace_back(attr, value);
+		}
+
+		t->nodes.push_back(node);
+
+		if (kind <= BUILD_SCROLL)
+			depth++;
+	}
+
+	if (depth != 0)
+		return parse_error(t, line, "missing 'end'");
+
+	return t;
+}
+
+extern "C" const char* WidgetBuilder_Error() {
+	return builder_error;
+}
+
+static Fl_Widget* create_widget(const BuilderNode& n, int x, int y) {
+	switch (n.kind) {
+	case BUILD_WINDOW: return new Fl_Window(x, y, n.w, n.h);
+	case BUILD_DOUBLE_WINDOW: return new Fl_Double_Window(x, y, n.w, n.h);
+	case BUILD_GROUP: return new Fl_Group(x, y, n.w, n.h);
+	case BUILD_PACK: return new Fl_Pack(x, y, n.w, n.h);
+	case BUILD_SCROLL: return new Fl_Scroll(x, y, n.w, n.h);
+	case BUILD_BOX: return new Fl_Box(x, y, n.w, n.h);
+	case BUILD_BUTTON: return new Fl_Button(x, y, n.w, n.h);
+	case BUILD_CHECK_BUTTON: return new Fl_Check_Button(x, y, n.w, n.h);
+	case BUILD_LIGHT_BUTTON: return new Fl_Light_Button(x, y, n.w, n.h);
+	case BUILD_INPUT: return new Fl_Input(x, y, n.w, n.h);
+	case BUILD_VALUE_INPUT: return new Fl_Value_Input(x, y, n.w, n.h);
+	case BUILD_VALUE_OUTPUT: return new Fl_Value_Output(x, y, n.w, n.h);
+	case BUILD_CHOICE: return new Fl_Choice(x, y, n.w, n.h);
+	case BUILD_PROGRESS: return new Fl_Progress(x, y, n.w, n.h);
+	case BUILD_TEXT_DISPLAY: return new Fl_Text_Display(x, y, n.w, n.h);
+	case BUILD_TEXT_EDITOR: return new Fl_Text_Editor(x, y, n.w, n.h);
+	default: return nullptr;
+	}
+}
+
+static void apply_attrs(const BuilderNode& n, Fl_Widget* w) {
+	if (!n.label.empty())
+		w->copy_label(n.label.c_str());
+
+	if (!n.tooltip.empty())
+		w->copy_tooltip(n.tooltip.c_str());
+
+	for (const auto& a : n.attrs) {
+		switch (a.first) {
+		case ATTR_BOX: w->box((Fl_Boxtype)a.second); break;
+		case ATTR_COLOR: w->color((Fl_Color)a.second); break;
+		case ATTR_SELECTION_COLOR: w->selection_color((Fl_Color)a.second); break;
+		case ATTR_LABELCOLOR: w->labelcolor((Fl_Color)a.second); break;
+		case ATTR_LABELFONT: w->labelfont((Fl_Font)a.second); break;
+		case ATTR_LABELSIZE: w->labelsize((Fl_Fontsize)a.second); break;
+		case ATTR_LABELTYPE: w->labeltype((Fl_Labeltype)a.second); break;
+		case ATTR_ALIGN: w->align((Fl_Align)a.second); break;
+		case ATTR_WHEN: w->when((uchar)a.second); break;
+		case ATTR_TYPE: w->type((uchar)a.second); break;
+		case ATTR_RESIZABLE:
+			if (w->parent() != nullptr)
+				w->parent()->resizable(w);
+			break;
+		case ATTR_HIDE: w->hide(); break;
+		case ATTR_DEACTIVATE: w->deactivate(); break;
+		}
+	}
+}
+
+// Creates the widgets of t inside parent (or at top level if null), offset by
+// dx, dy. Writes the widgets marked @name to handles, which must have room for
+// WidgetBuilder_HandleCount(t) entries. Returns the first top-level widget.
+extern "C" Fl_Widget* WidgetBuilder_Instantiate(WidgetTemplate* t, Fl_Group* parent, int dx, int dy, Fl_Widget** handles) {
+	Fl_Group* saved = Fl_Group::current();
+	Fl_Widget* first = nullptr;
+	std::vector<Fl_Group*> open;
+	int windows = 0;  // open windows of the template
+
+	Fl_Group::current(parent);
+
+	for (const BuilderNode& n : t->nodes) {
+		if (n.kind == BUILD_END) {
+			if (open.back()->as_window() != nullptr)
+				windows--;
+
+			open.back()->end();
+			open.pop_back();
+			Fl_Group::current(open.empty() ? parent : open.back());
+			continue;
+		}
+
+		// Widgets add themselves to Fl_Group::current(), and containers make
+		// themselves current until their end().
+		Fl_Widget* w = windows > 0 ? create_widget(n, n.x, n.y) : create_widget(n, n.x + dx, n.y + dy);
+
+		apply_attrs(n, w);
+
+		if (first == nullptr)
+			first = w;
+
+		if (n.handle >= 0 && handles != nullptr)
+			handles[n.handle] = w;
+
+		if (n.kind <= BUILD_SCROLL)
+			open.push_back((Fl_Group*)w);
+		if (w->as_window() != nullptr)
+			windows++;
+	}
+
+	Fl_Group::current(saved);
+	return first;
+}
+
+extern "C" int WidgetBuilder_HandleCount(WidgetTemplate* t) {
+	return (int)t->handles.size();
+}
+
+// Index of the widget marked @name in the handle table, or -1.
+extern "C" int WidgetBuilder_HandleIndex(WidgetTemplate* t, const char* name) {
+	for (size_t i = 0; i < t->handles.size(); i++) {
+		if (t->handles[i] == name)
+			return (int)i;
+	}
+
+	return -1;
+}
+
+extern "C" void WidgetBuilder_Free(WidgetTemplate* t) {
+	delete t;
+}